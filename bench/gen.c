@@ -0,0 +1,223 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Deterministic generator of large assembly sources for `make bench`.
+ *
+ *   gen [-n LINES] [-s SEED] [-w SHAPE=WEIGHT,...] [-c PCT] [-b PCT]
+ *       [-t PCT]
+ *
+ * SHAPE is one of the operand shapes from isa.h (none, rr, trap, ri19,
+ * rpc19, pc23, r, rrr, rri15, mem). -c, -b and -t set the percentage
+ * of comment lines, blank lines and tab-indented lines.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../isa.h"
+
+#define NSHAPES  (FMT_RAW)
+#define LBLEVERY (16)
+#define LBLRANGE (32)
+
+static unsigned long seed = 1;
+static int weights[NSHAPES] = {
+  /* none rr trap ri19 rpc19 pc23 r rrr rri15 mem */
+     1,   6, 1,   6,   1,    3,   3, 8,  6,    6
+};
+static int ops[NSHAPES][ISA_NOPS];
+static int nops[NSHAPES];
+
+
+/* xorshift32 */
+static unsigned long rnd (unsigned long n)
+{
+  seed ^= (seed << 13) & 0xfffffffful;
+  seed ^= seed >> 17;
+  seed ^= (seed << 5) & 0xfffffffful;
+  return n ? seed % n : 0;
+}
+
+
+static char *reg (void)
+{
+  static char *regs[] = {
+    "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9",
+    "r10", "r11", "r12", "r13", "r14", "sp"
+  };
+  return regs[rnd(16)];
+}
+
+
+static unsigned long target (unsigned long line, unsigned long nlbl)
+{
+  long k = (long)(line / LBLEVERY) + (long)rnd(2*LBLRANGE+1) - LBLRANGE;
+  if (k < 0)
+    k = 0;
+  if ((unsigned long)k >= nlbl)
+    k = (long)nlbl - 1;
+  return (unsigned long)k;
+}
+
+
+static int set_weights (char *spec)
+{
+  char *p = strtok(spec, ",");
+  for (; p; p = strtok(NULL, ",")) {
+    char *eq = strchr(p, '=');
+    int f;
+    if (!eq)
+      return 0;
+    *eq = '\0';
+    for (f = 0; f < NSHAPES; f++)
+      if (strcmp(p, isa_fmtname((InstFmt)f)) == 0)
+        break;
+    if (f == NSHAPES)
+      return 0;
+    weights[f] = atoi(eq + 1);
+  }
+  return 1;
+}
+
+
+static int pick_shape (int total)
+{
+  int f, r = (int)rnd((unsigned long)total);
+  for (f = 0; f < NSHAPES; f++) {
+    if (!nops[f])
+      continue;
+    if (r < weights[f])
+      return f;
+    r -= weights[f];
+  }
+  return FMT_NONE;
+}
+
+
+static void gen_inst (char *buf, int f, unsigned long line,
+                      unsigned long nlbl)
+{
+  char *op = to_mnemonic(ops[f][rnd(nops[f])]);
+  switch ((InstFmt)f) {
+    case FMT_RR:
+      sprintf(buf, "%s %s, %s", op, reg(), reg());
+      break;
+    case FMT_TRAP:
+      sprintf(buf, "%s #%lu", op, rnd(256));
+      break;
+    case FMT_RI19:
+      sprintf(buf, "%s %s, #%ld", op, reg(), (long)rnd(2001) - 1000);
+      break;
+    case FMT_RPC19:
+      sprintf(buf, "%s %s, L%lu", op, reg(), target(line, nlbl));
+      break;
+    case FMT_PC23:
+      sprintf(buf, "%s L%lu", op, target(line, nlbl));
+      break;
+    case FMT_R:
+      sprintf(buf, "%s %s", op, reg());
+      break;
+    case FMT_RRR:
+      sprintf(buf, "%s %s, %s, %s", op, reg(), reg(), reg());
+      break;
+    case FMT_RRI15:
+      sprintf(buf, "%s %s, %s, #0x%lx", op, reg(), reg(), rnd(4096));
+      break;
+    case FMT_MEM:
+      if (rnd(2))
+        sprintf(buf, "%s %s, [%s]", op, reg(), reg());
+      else
+        sprintf(buf, "%s %s, [%s + #%ld]", op, reg(), reg(),
+                (long)rnd(129) - 64);
+      break;
+    default:
+      sprintf(buf, "%s", op);
+      break;
+  }
+}
+
+
+int main (int argc, char **argv)
+{
+  unsigned long lines = 1000, i, nlbl;
+  int cmt = 10, blank = 5, tabs = 30, total = 0, f, k;
+  char inst[96];
+
+  for (k = 1; k < argc; k++) {
+    if (k+1 >= argc)
+      goto usage;
+    if (strcmp(argv[k], "-n") == 0)
+      lines = strtoul(argv[++k], NULL, 0);
+    else if (strcmp(argv[k], "-s") == 0)
+      seed = strtoul(argv[++k], NULL, 0) | 1;
+    else if (strcmp(argv[k], "-c") == 0)
+      cmt = atoi(argv[++k]);
+    else if (strcmp(argv[k], "-b") == 0)
+      blank = atoi(argv[++k]);
+    else if (strcmp(argv[k], "-t") == 0)
+      tabs = atoi(argv[++k]);
+    else if (strcmp(argv[k], "-w") != 0 || !set_weights(argv[++k]))
+      goto usage;
+  }
+
+  for (k = 0; k < ISA_NOPS; k++) {
+    int opc = isa_opcode(k);
+    f = isa_fmt(opc);
+    if (f < NSHAPES)
+      ops[f][nops[f]++] = opc;
+  }
+  for (f = 0; f < NSHAPES; f++)
+    if (nops[f] && weights[f] > 0)
+      total += weights[f];
+    else
+      weights[f] = 0;
+  if (!total)
+    goto usage;
+
+  nlbl = (lines + LBLEVERY - 1) / LBLEVERY;
+  printf("; generated by bench/gen -n %lu\n", lines);
+  printf("L0:\tnop\n");
+  for (i = 2; i < lines; i++) {
+    unsigned long r = rnd(100);
+    char *ind = rnd(100) < (unsigned long)tabs ? "\t" : "    ";
+    /* every LBLEVERY-th line is a labelled instruction */
+    if (i % LBLEVERY == 0) {
+      gen_inst(inst, pick_shape(total), i, nlbl);
+      printf("L%lu:%s%s\n", i / LBLEVERY, ind, inst);
+    }
+    else if (r < (unsigned long)blank)
+      putchar('\n');
+    else if (r < (unsigned long)(blank + cmt))
+      printf("; comment %lu\n", i);
+    else {
+      gen_inst(inst, pick_shape(total), i, nlbl);
+      if (rnd(10) == 0)
+        printf("%s%s\t; note\n", ind, inst);
+      else
+        printf("%s%s\n", ind, inst);
+    }
+  }
+  return 0;
+
+usage:
+  fprintf(stderr, "usage: %s [-n LINES] [-s SEED] [-w SHAPE=WEIGHT,...]"
+                  " [-c PCT] [-b PCT] [-t PCT]\n", argv[0]);
+  return 1;
+}
@@ -0,0 +1,103 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs a command and reports its wall time and peak RSS.
+ *
+ *   measure [-o FILE] [-q] CMD [ARG...]
+ *
+ * Prints "WALL_SECONDS RSS_KB" to FILE (or stderr). -q sends the
+ * command's stdout to /dev/null.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+int main (int argc, char **argv)
+{
+  FILE *out = stderr;
+  struct rusage ru;
+  double t0, t1;
+  pid_t pid;
+  int k = 1, quiet = 0, status;
+
+  for (; k < argc && argv[k][0] == '-'; k++) {
+    if (strcmp(argv[k], "-o") == 0 && k+1 < argc) {
+      out = fopen(argv[++k], "w");
+      if (!out) {
+        perror(argv[k]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[k], "-q") == 0)
+      quiet = 1;
+    else
+      break;
+  }
+  if (k >= argc) {
+    fprintf(stderr, "usage: %s [-o FILE] [-q] CMD [ARG...]\n", argv[0]);
+    return 1;
+  }
+
+  t0 = now();
+  pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return 1;
+  }
+  if (pid == 0) {
+    if (quiet) {
+      int fd = open("/dev/null", O_WRONLY);
+      if (fd >= 0)
+        dup2(fd, 1);
+    }
+    execvp(argv[k], &argv[k]);
+    perror(argv[k]);
+    _exit(127);
+  }
+  if (waitpid(pid, &status, 0) < 0) {
+    perror("waitpid");
+    return 1;
+  }
+  t1 = now();
+  getrusage(RUSAGE_CHILDREN, &ru);
+
+  /* ru_maxrss is in kilobytes on Linux */
+  fprintf(out, "%.6f %ld\n", t1 - t0, (long)ru.ru_maxrss);
+  if (out != stderr)
+    fclose(out);
+  if (!WIFEXITED(status))
+    return 1;
+  return WEXITSTATUS(status);
+}
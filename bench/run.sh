@@ -0,0 +1,61 @@
+#!/bin/sh
+#
+#  rvasm -- An assembler and disassembler for rvm.
+#  Copyright (C) 2025  Vincent Yanzee J. Tan
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+# Throughput benchmark, run by `make bench`.
+#
+#   BENCH_SIZES   source sizes in lines (default: 1000 100000 1000000)
+#   BENCH_OUT     results file (default: bench/results.txt)
+#   BENCH_SEED    generator seed (default: 1)
+#
+# Appends one row per size to the results file:
+#   rev lines bytes insts lex_MB/s asm_insts/s dis_insts/s asm_rss_kb
+#   dis_rss_kb
+
+set -e
+
+dir=$(dirname "$0")
+sizes=${BENCH_SIZES:-"1000 100000 1000000"}
+out=${BENCH_OUT:-$dir/results.txt}
+seed=${BENCH_SEED:-1}
+work=$dir/out
+rev=$(git -C "$dir" rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+mkdir -p "$work"
+if [ ! -s "$out" ]; then
+  echo "# rev lines bytes insts lex_MB/s asm_insts/s dis_insts/s" \
+       "asm_rss_kb dis_rss_kb" > "$out"
+fi
+
+for n in $sizes; do
+  src=$work/gen$n.S
+  img=$work/gen$n.bin
+  "$dir/gen" -n "$n" -s "$seed" > "$src"
+
+  "$dir/measure" -o "$work/lex.m" ./rvasm --lex-only "$src"
+  "$dir/measure" -o "$work/asm.m" ./rvasm -o "$img" "$src"
+  "$dir/measure" -q -o "$work/dis.m" ./rvdis "$img"
+
+  bytes=$(wc -c < "$src")
+  insts=$(( $(wc -c < "$img") / 4 ))
+  set -- $(cat "$work/lex.m") $(cat "$work/asm.m") $(cat "$work/dis.m")
+  awk -v rev="$rev" -v n="$n" -v b="$bytes" -v i="$insts" \
+      -v lt="$1" -v at="$3" -v ar="$4" -v dt="$5" -v dr="$6" 'BEGIN {
+    printf "%s %d %d %d %.2f %.0f %.0f %d %d\n", rev, n, b, i,
+      b / 1e6 / lt, i / at, i / dt, ar, dr
+  }' | tee -a "$out"
+done
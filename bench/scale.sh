@@ -0,0 +1,89 @@
+#!/bin/sh
+#
+#  rvasm -- An assembler and disassembler for rvm.
+#  Copyright (C) 2025  Vincent Yanzee J. Tan
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+# Complexity regression check, run by `make scale`.
+#
+#   SCALE_BASE    smallest input in lines (default: 100000)
+#   SCALE_STEPS   number of doublings (default: 3)
+#   SCALE_SLACK   allowed excess over linear growth (default: 1.5)
+#
+# Every case is run at SCALE_BASE, then doubled SCALE_STEPS times. Time
+# and peak RSS from the smallest to the largest run may grow by at most
+# 2^SCALE_STEPS * SCALE_SLACK; anything steeper fails the check.
+
+set -e
+
+dir=$(dirname "$0")
+base=${SCALE_BASE:-100000}
+steps=${SCALE_STEPS:-3}
+slack=${SCALE_SLACK:-1.5}
+work=$dir/out
+fail=0
+
+mkdir -p "$work"
+
+# CASE LINES: writes a source of about LINES lines to $src
+gen_case () {
+  case $1 in
+    mixed)    "$dir/gen" -n "$2" > "$src" ;;
+    branches) "$dir/gen" -n "$2" -w pc23=1,rpc19=1 > "$src" ;;
+    comments) "$dir/gen" -n "$2" -c 80 -b 10 > "$src" ;;
+    # one line, no newline until the end
+    longline) awk -v n="$2" 'BEGIN {
+                for (i = 0; i < n; i++) printf "; xxxxxxxxxxxxxxxxxxxxxxxx"
+                printf "\n\tnop\n" }' > "$src" ;;
+    # many labels, each jumped to from far away
+    labels)   awk -v n="$2" 'BEGIN {
+                for (i = 0; i < n; i++)
+                  printf "l%d:\tj l%d\n", i, n - 1 - i }' > "$src" ;;
+  esac
+}
+
+# NAME T0 T1 LIMIT: fails when T1/T0 exceeds LIMIT
+check () {
+  awk -v name="$1" -v a="$2" -v b="$3" -v lim="$4" 'BEGIN {
+    r = a > 0 ? b / a : 0
+    printf "  %-18s x%-8.2f (limit x%.2f)%s\n", name, r, lim,
+           (r > lim) ? "  FAIL" : ""
+    exit (r > lim)
+  }' || fail=1
+}
+
+limit=$(awk -v s="$steps" -v k="$slack" 'BEGIN { print 2^s * k }')
+
+for c in mixed branches comments longline labels; do
+  n=$base
+  i=0
+  echo "$c: $base..$(( base << steps )) lines"
+  while [ $i -le "$steps" ]; do
+    src=$work/scale.S
+    gen_case "$c" "$n"
+    "$dir/measure" -o "$work/asm$i.m" ./rvasm -o "$work/scale.bin" "$src"
+    "$dir/measure" -q -o "$work/dis$i.m" ./rvdis "$work/scale.bin"
+    n=$(( n * 2 ))
+    i=$(( i + 1 ))
+  done
+  set -- $(cat "$work/asm0.m") $(cat "$work/asm$steps.m")
+  check "rvasm time" "$1" "$3" "$limit"
+  check "rvasm rss" "$2" "$4" "$limit"
+  set -- $(cat "$work/dis0.m") $(cat "$work/dis$steps.m")
+  check "rvdis time" "$1" "$3" "$limit"
+  check "rvdis rss" "$2" "$4" "$limit"
+done
+
+exit $fail
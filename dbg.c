@@ -0,0 +1,154 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Debug sidecar: a pc -> file:line table and a symbol table, written
+ * next to the image as `<image>.dbg`. All numbers are LEB128.
+ *
+ *   "RVDG" u8 version
+ *   uleb nfiles    { uleb len, char name[len] }
+ *   uleb nsyms     { uleb addr, uleb len, char name[len] }
+ *   uleb nrows     { uleb (pc_delta << 1 | file_changed),
+ *                    [uleb file,]  sleb line_delta }
+ *
+ * Addresses are in bytes, pc deltas in words. A row covers every pc
+ * from its own up to the next row's; rows are only emitted when the
+ * file or line changes.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rvasm.h"
+
+#define DBG_VERSION  (1)
+
+static int dbg_on = 0;
+static ByteBuf files, rows;
+static unsigned long nfiles, nrows;
+static char *last_fname;
+static unsigned long last_file, row_file, row_pc;
+static sloc_t row_line;
+
+
+void dbg_init (void)
+{
+  dbg_on = 1;
+  bb_init(&files);
+  bb_init(&rows);
+  nfiles = nrows = 0;
+  last_fname = NULL;
+  last_file = row_file = row_pc = 0;
+  row_line = 0;
+}
+
+
+void dbg_free (void)
+{
+  if (!dbg_on)
+    return;
+  bb_free(&files);
+  bb_free(&rows);
+  dbg_on = 0;
+}
+
+
+static unsigned long file_index (char *fname)
+{
+  char **tab = (char**)(void*)files.data;
+  unsigned long i;
+  for (i = 0; i < nfiles; i++)
+    if (tab[i] == fname || strcmp(tab[i], fname) == 0)
+      return i;
+  bb_write(&files, &fname, sizeof(fname));
+  return nfiles++;
+}
+
+
+void dbg_line (rpos_t loc, char *fname, sloc_t line)
+{
+  unsigned long pc = loc >> 2;
+  int fchg;
+  if (!dbg_on)
+    return;
+  if (fname != last_fname) {
+    last_file = file_index(fname);
+    last_fname = fname;
+  }
+  fchg = !nrows || last_file != row_file;
+  if (!fchg && line == row_line)
+    return;
+  bb_uleb(&rows, ((pc - row_pc) << 1) | fchg);
+  if (fchg)
+    bb_uleb(&rows, last_file);
+  bb_sleb(&rows, (long)line - (long)row_line);
+  row_pc = pc;
+  row_file = last_file;
+  row_line = line;
+  nrows++;
+}
+
+
+static void put_str (ByteBuf *bb, char *s, size_t len)
+{
+  bb_uleb(bb, len);
+  bb_write(bb, s, len);
+}
+
+
+int dbg_write (char *path)
+{
+  ByteBuf hdr;
+  OutFile of;
+  Symbol *sym;
+  unsigned long i, nsyms = 0;
+  char **tab = (char**)(void*)files.data;
+  int ok;
+
+  bb_init(&hdr);
+  bb_write(&hdr, "RVDG", 4);
+  bb_uleb(&hdr, DBG_VERSION);
+  bb_uleb(&hdr, nfiles);
+  for (i = 0; i < nfiles; i++)
+    put_str(&hdr, tab[i], strlen(tab[i]));
+
+  for (sym = sym_list(); sym; sym = sym->link)
+    if (sym->def)
+      nsyms++;
+  bb_uleb(&hdr, nsyms);
+  for (sym = sym_list(); sym; sym = sym->link) {
+    if (!sym->def)
+      continue;
+    bb_uleb(&hdr, sym->def->loc);
+    put_str(&hdr, sym->name, sym->len);
+  }
+  bb_uleb(&hdr, nrows);
+
+  if (hdr.err || rows.err || !out_open(&of, path, hdr.len + rows.len)) {
+    diag_msg("could not write debug info: %s", path);
+    bb_free(&hdr);
+    return 0;
+  }
+  ok = fwrite(hdr.data, 1, hdr.len, of.fp) == hdr.len &&
+       fwrite(rows.data, 1, rows.len, of.fp) == rows.len;
+  ok = out_commit(&of, ok);
+  if (!ok)
+    diag_msg("could not write debug info: %s", path);
+  bb_free(&hdr);
+  return ok;
+}
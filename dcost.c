@@ -0,0 +1,657 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Static cost report (--cost).
+ *
+ * Every instruction is charged its opcode's weight from a cost table,
+ * times LOOPW to the power of its loop depth. Blocks come from
+ * isa_leaders(), and functions start at the image start and at every
+ * call or adr target, named from `FILE.dbg` when there is one. Loops
+ * are natural loops: an edge to a block that dominates its source
+ * closes one, and each loop header adds one level of depth to the
+ * blocks that reach the edge without passing the header, however many
+ * back edges it has. Function costs are their own, a call is only
+ * charged its weight.
+ *
+ * A cost table has one "MNEMONIC WEIGHT" per line, `#` comments, and
+ * a trailing `*` to match a prefix (`rd* 4`). It overrides the default
+ * table below; anything unlisted costs 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rvm/rvm.h"
+#include "isa.h"
+#include "rvdis.h"
+#include "utils.h"
+
+#define NIDX      (ISA_NOPS + 1)  /* known opcodes + .raw */
+#define MAXDEPTH  (8)             /* deeper loops weigh the same */
+#define NOBLK     ((unsigned long)-1)
+
+typedef struct {
+  unsigned long start, end;  /* word indices, [start, end) */
+  unsigned long fn;
+  int depth;
+  double mult;               /* LOOPW^depth */
+  double cost;
+} Block;
+
+typedef struct {
+  unsigned long start;
+  char *name;
+  unsigned long insts, blocks, loops;
+  double cost, mem;
+} Func;
+
+static char default_table[] =
+  "div 20\n"  "divs 20\n"  "divi 20\n"  "divsi 20\n"
+  "mod 20\n"  "modi 20\n"
+  "mul 3\n"   "muls 3\n"   "muli 3\n"   "mulsi 3\n"
+  "rd* 4\n"   "wr* 4\n"
+  "call 3\n"  "callr 3\n"  "ret 2\n"    "trap 10\n";
+
+static double weight[NIDX];
+static int loaded = 0;
+static unsigned long topn = 10;
+static double loopw = 10.0;
+
+
+/*
+ * Applies a cost table. `quiet` skips unknown mnemonics, for the
+ * default table across rvm versions.
+ */
+static int parse_table (char *prog, char *name, char *s, int quiet)
+{
+  unsigned long line = 0;
+  while (*s) {
+    char *word, *end;
+    size_t len;
+    double w;
+    int idx, hit = 0, prefix;
+
+    line++;
+    while (*s == ' ' || *s == '\t')
+      s++;
+    word = s;
+    while (*s && *s != ' ' && *s != '\t' && *s != '\n' && *s != '#')
+      s++;
+    len = (size_t)(s - word);
+    w = strtod(s, &end);
+    if (!len || *word == '#') {
+      s = strchr(s, '\n');
+      s = s ? s + 1 : word + strlen(word);
+      continue;
+    }
+    if (end == s || w < 0) {
+      printf("%s: %s:%lu: expected a weight\n", prog, name, line);
+      return 0;
+    }
+    s = end;
+    while (*s && *s != '\n')
+      s++;
+    if (*s)
+      s++;
+
+    prefix = word[len-1] == '*';
+    if (prefix)
+      len--;
+    for (idx = 0; idx < ISA_NOPS; idx++) {
+      char *mn = to_mnemonic(isa_opcode(idx));
+      if (strncmp(mn, word, len) == 0 && (prefix || mn[len] == '\0')) {
+        weight[idx] = w;
+        hit = 1;
+      }
+    }
+    if (!hit && !quiet) {
+      printf("%s: %s:%lu: unknown opcode: %.*s\n", prog, name, line,
+             (int)len + prefix, word);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+static void load_defaults (void)
+{
+  int i;
+  if (loaded)
+    return;
+  for (i = 0; i < NIDX; i++)
+    weight[i] = 1.0;
+  parse_table(NULL, NULL, default_table, 1);
+  loaded = 1;
+}
+
+
+int cost_load (char *prog, char *path)
+{
+  size_t sz;
+  char *text = read_ascii_file(path, &sz);
+  int ok;
+  if (!text) {
+    printf("%s: Could not read cost table: %s\n", prog, path);
+    return 0;
+  }
+  load_defaults();
+  ok = parse_table(prog, path, text, 0);
+  free(text);
+  return ok;
+}
+
+
+void cost_set (unsigned long top, unsigned long loop)
+{
+  if (top)
+    topn = top;
+  if (loop)
+    loopw = (double)loop;
+}
+
+
+static int cmp_ulong (const void *a, const void *b)
+{
+  unsigned long x = *(const unsigned long*)a, y = *(const unsigned long*)b;
+  return x < y ? -1 : x > y;
+}
+
+
+/*
+ * Function starts, sorted and unique. Names come from `di` if given.
+ */
+static unsigned long find_funcs (Func **out, rvm_inst_t *insts,
+                                 unsigned long n, DbgInfo *di)
+{
+  unsigned long *starts, nst = 0, i, k;
+  Func *fn;
+
+  starts = (unsigned long*)malloc((n + 1) * sizeof(unsigned long));
+  if (!starts)
+    return 0;
+  /* labels are mostly local, only called or address-taken ones count */
+  starts[nst++] = 0;
+  for (i = 0; i < n; i++) {
+    int opc = RVM_OPC(insts[i]);
+    long t;
+    if (opc != RVM_OP_call && opc != RVM_OP_adr)
+      continue;
+    t = isa_target(i, insts[i]);
+    if (t >= 0 && (unsigned long)t < n)
+      starts[nst++] = (unsigned long)t;
+  }
+  qsort(starts, nst, sizeof(unsigned long), cmp_ulong);
+  for (i = k = 0; i < nst; i++)
+    if (!k || starts[k-1] != starts[i])
+      starts[k++] = starts[i];
+  nst = k;
+
+  fn = (Func*)calloc(nst, sizeof(Func));
+  if (!fn) {
+    free(starts);
+    return 0;
+  }
+  for (i = 0, k = 0; i < nst; i++) {
+    fn[i].start = starts[i];
+    /* the first symbol at this address names it */
+    if (di) {
+      while (k < di->nsyms && di->syms[k].addr < (starts[i] << 2))
+        k++;
+      if (k < di->nsyms && di->syms[k].addr == (starts[i] << 2))
+        fn[i].name = di->syms[k].name;
+    }
+  }
+  free(starts);
+  *out = fn;
+  return nst;
+}
+
+
+static char *fn_name (Func *f, char *buf)
+{
+  if (f->name)
+    return f->name;
+  sprintf(buf, "fn_%08lx", f->start << 2);
+  return buf;
+}
+
+
+/* indices of the `k` largest of `cost`, by descending cost. */
+static unsigned long top_k (unsigned long *out, unsigned long k,
+                           double (*cost)(void*, unsigned long), void *arr,
+                           unsigned long n)
+{
+  unsigned long i, j, cnt = 0;
+  for (i = 0; i < n; i++) {
+    double c = cost(arr, i);
+    if (cnt == k && cost(arr, out[k-1]) >= c)
+      continue;
+    j = cnt < k ? cnt++ : k - 1;
+    for (; j > 0 && cost(arr, out[j-1]) < c; j--)
+      out[j] = out[j-1];
+    out[j] = i;
+  }
+  return cnt;
+}
+
+
+static double fn_cost (void *arr, unsigned long i)
+{
+  return ((Func*)arr)[i].cost;
+}
+
+
+static double blk_cost (void *arr, unsigned long i)
+{
+  return ((Block*)arr)[i].cost;
+}
+
+
+static double mix_cost (void *arr, unsigned long i)
+{
+  return ((double*)arr)[i];
+}
+
+
+static void report (char *path, rvm_inst_t *insts, unsigned long n,
+                    Func *fn, unsigned long nfn, Block *blk,
+                    unsigned long nblk, unsigned long *bof)
+{
+  unsigned long cnt[NIDX], *top, ntop, i, k;
+  double wcost[NIDX], total = 0;
+  char buf[32];
+
+  memset(cnt, 0, sizeof(cnt));
+  memset(wcost, 0, sizeof(wcost));
+  for (i = 0; i < n; i++) {
+    int idx = isa_index(RVM_OPC(insts[i]));
+    cnt[idx]++;
+    wcost[idx] += weight[idx] * blk[bof[i]].mult;
+  }
+  for (i = 0; i < nfn; i++)
+    total += fn[i].cost;
+
+  top = (unsigned long*)malloc((topn > NIDX ? topn : NIDX) *
+                               sizeof(unsigned long));
+  if (!top)
+    return;
+
+  printf("Cost report for file:   %s\n", path);
+  printf("loop weight %g, total cost %.0f\n\n", loopw, total);
+
+  ntop = top_k(top, topn, fn_cost, fn, nfn);
+  printf("functions (top %lu of %lu)\n", ntop, nfn);
+  printf("  %12s %6s %8s %7s %6s %12s  %s\n", "cost", "%", "insts",
+         "blocks", "loops", "mem", "name");
+  for (i = 0; i < ntop; i++) {
+    Func *f = &fn[top[i]];
+    printf("  %12.0f %6.2f %8lu %7lu %6lu %12.0f  %s\n", f->cost,
+           total ? 100.0 * f->cost / total : 0.0, f->insts, f->blocks,
+           f->loops, f->mem, fn_name(f, buf));
+  }
+
+  ntop = top_k(top, topn, blk_cost, blk, nblk);
+  printf("\nblocks (top %lu of %lu)\n", ntop, nblk);
+  printf("  %12s %6s %8s %6s %8s  %s\n", "cost", "%", "addr", "insts",
+         "depth", "function");
+  for (i = 0; i < ntop; i++) {
+    Block *b = &blk[top[i]];
+    printf("  %12.0f %6.2f %08lx %6lu %8d  %s\n", b->cost,
+           total ? 100.0 * b->cost / total : 0.0, b->start << 2,
+           b->end - b->start, b->depth, fn_name(&fn[b->fn], buf));
+  }
+
+  ntop = top_k(top, NIDX, mix_cost, wcost, NIDX);
+  printf("\ninstruction mix\n");
+  printf("  %-8s %8s %8s %12s %6s\n", "opcode", "count", "weight",
+         "cost", "%");
+  for (i = 0; i < ntop; i++) {
+    k = top[i];
+    if (!cnt[k])
+      continue;
+    printf("  %-8s %8lu %8g %12.0f %6.2f\n",
+           k < ISA_NOPS ? to_mnemonic(isa_opcode((int)k)) : ".raw",
+           cnt[k], weight[k], wcost[k],
+           total ? 100.0 * wcost[k] / total : 0.0);
+  }
+  putc('\n', stdout);
+  free(top);
+}
+
+
+/*
+ * Control flow successors of block `b` within its function.
+ */
+static void successors (unsigned long *succ, Block *blk, unsigned long nblk,
+                        unsigned long *bof, rvm_inst_t *insts,
+                        unsigned long n, unsigned long b)
+{
+  unsigned long last = blk[b].end - 1;
+  int opc = RVM_OPC(insts[last]);
+  long t;
+
+  succ[0] = succ[1] = NOBLK;
+  if (!isa_isterm(opc) && b + 1 < nblk && blk[b+1].fn == blk[b].fn)
+    succ[0] = b + 1;
+  if (!isa_isbranch(opc) || opc == RVM_OP_call || opc == RVM_OP_ret ||
+      isa_fmt(opc) == FMT_R)
+    return;
+  t = isa_target(last, insts[last]);
+  if (t >= 0 && (unsigned long)t < n && blk[bof[t]].fn == blk[b].fn)
+    succ[1] = bof[t];
+}
+
+
+/*
+ * Dominators of one function's blocks [fb, fe), by the iterative
+ * algorithm of Cooper, Harvey and Kennedy over reverse postorder.
+ * Unreachable blocks keep idom NOBLK.
+ */
+static void dominators (unsigned long *idom, unsigned long *rpo,
+                        unsigned long *order, unsigned long *stack,
+                        unsigned long (*succ)[2], unsigned long *pred,
+                        unsigned long *npred, unsigned long fb,
+                        unsigned long fe)
+{
+  unsigned long b, k, sp = 0, cnt = 0, *next = stack + (fe - fb);
+  int changed = 1;
+
+  for (b = fb; b < fe; b++) {
+    idom[b] = NOBLK;
+    rpo[b] = NOBLK;
+    next[b - fb] = 0;
+  }
+  /* postorder, iteratively; `rpo` marks visited until numbered */
+  stack[sp++] = fb;
+  rpo[fb] = 0;
+  while (sp) {
+    unsigned long x = stack[sp-1], s;
+    if (next[x - fb] < 2) {
+      s = succ[x][next[x - fb]++];
+      if (s != NOBLK && rpo[s] == NOBLK) {
+        rpo[s] = 0;
+        stack[sp++] = s;
+      }
+      continue;
+    }
+    order[cnt++] = x;
+    sp--;
+  }
+  /* reverse it, numbering in reverse postorder */
+  for (k = 0; k < cnt / 2; k++) {
+    unsigned long x = order[k];
+    order[k] = order[cnt-1-k];
+    order[cnt-1-k] = x;
+  }
+  for (k = 0; k < cnt; k++)
+    rpo[order[k]] = k;
+
+  idom[fb] = fb;
+  while (changed) {
+    changed = 0;
+    for (k = 1; k < cnt; k++) {
+      unsigned long x = order[k], nd = NOBLK, p;
+      for (p = x ? npred[x-1] : 0; p < npred[x]; p++) {
+        unsigned long y = pred[p];
+        if (idom[y] == NOBLK)
+          continue;
+        if (nd == NOBLK) {
+          nd = y;
+          continue;
+        }
+        while (nd != y) {
+          while (rpo[nd] > rpo[y])
+            nd = idom[nd];
+          while (rpo[y] > rpo[nd])
+            y = idom[y];
+        }
+      }
+      if (nd != idom[x]) {
+        idom[x] = nd;
+        changed = 1;
+      }
+    }
+  }
+}
+
+
+/*
+ * Loop depth of every block, from natural loops.
+ */
+static int find_loops (Block *blk, unsigned long nblk, unsigned long *bof,
+                       rvm_inst_t *insts, unsigned long n, Func *fn)
+{
+  unsigned long (*succ)[2], *npred, *pred, *idom, *rpo, *order, *stack;
+  unsigned long *seen, b, h, fb, fe, k;
+  int s;
+
+  succ = (unsigned long(*)[2])malloc((nblk + 1) * sizeof(*succ));
+  npred = (unsigned long*)calloc(nblk + 1, sizeof(unsigned long));
+  pred = (unsigned long*)malloc((2 * nblk + 1) * sizeof(unsigned long));
+  idom = (unsigned long*)malloc((nblk + 1) * sizeof(unsigned long));
+  rpo = (unsigned long*)malloc((nblk + 1) * sizeof(unsigned long));
+  order = (unsigned long*)malloc((nblk + 1) * sizeof(unsigned long));
+  stack = (unsigned long*)malloc((2 * nblk + 1) * sizeof(unsigned long));
+  seen = (unsigned long*)malloc((nblk + 1) * sizeof(unsigned long));
+  if (!succ || !npred || !pred || !idom || !rpo || !order || !stack ||
+      !seen) {
+    free(succ);
+    free(npred);
+    free(pred);
+    free(idom);
+    free(rpo);
+    free(order);
+    free(stack);
+    free(seen);
+    return 0;
+  }
+
+  /* predecessors, packed; npred[b] ends b's run */
+  for (b = 0; b < nblk; b++) {
+    successors(succ[b], blk, nblk, bof, insts, n, b);
+    for (s = 0; s < 2; s++)
+      if (succ[b][s] != NOBLK)
+        npred[succ[b][s] + 1]++;
+  }
+  for (b = 0; b < nblk; b++)
+    npred[b+1] += npred[b];
+  for (b = 0; b < nblk; b++)
+    for (s = 0; s < 2; s++)
+      if (succ[b][s] != NOBLK)
+        pred[npred[succ[b][s]]++] = b;
+
+  for (b = 0; b < nblk; b++)
+    seen[b] = NOBLK;
+  for (fb = 0; fb < nblk; fb = fe) {
+    for (fe = fb + 1; fe < nblk && blk[fe].fn == blk[fb].fn; fe++)
+      ;;
+    dominators(idom, rpo, order, stack, succ, pred, npred, fb, fe);
+
+    /* one header at a time, with all of its back edges, so a loop is
+       walked whole and no inner loop can restamp it halfway */
+    for (h = fb; h < fe; h++) {
+      unsigned long sp = 0;
+      if (idom[h] == NOBLK)
+        continue;
+      for (k = h ? npred[h-1] : 0; k < npred[h]; k++) {
+        unsigned long x;
+        b = pred[k];
+        if (idom[b] == NOBLK || rpo[h] > rpo[b])
+          continue;
+        /* a back edge if the header dominates the source */
+        for (x = b; x != h && x != idom[x]; x = idom[x])
+          ;;
+        if (x != h)
+          continue;
+        if (seen[h] != h) {
+          seen[h] = h;
+          blk[h].depth++;
+          fn[blk[h].fn].loops++;
+        }
+        if (seen[b] != h) {
+          seen[b] = h;
+          blk[b].depth++;
+          stack[sp++] = b;
+        }
+      }
+      /* the loop body: everything reaching a back edge without h */
+      while (sp) {
+        unsigned long x = stack[--sp];
+        for (k = x ? npred[x-1] : 0; k < npred[x]; k++) {
+          unsigned long y = pred[k];
+          if (seen[y] == h || idom[y] == NOBLK)
+            continue;
+          seen[y] = h;
+          blk[y].depth++;
+          stack[sp++] = y;
+        }
+      }
+    }
+  }
+
+  free(succ);
+  free(npred);
+  free(pred);
+  free(idom);
+  free(rpo);
+  free(order);
+  free(stack);
+  free(seen);
+  return 1;
+}
+
+
+/*
+ * Splits the image into blocks, and finds their loop depth.
+ * `bof` maps each instruction to its block.
+ */
+static unsigned long build_cfg (Block **out, unsigned long *bof,
+                                rvm_inst_t *insts, unsigned long n,
+                                Func *fn, unsigned long nfn)
+{
+  unsigned char *lead = isa_leaders(insts, n);
+  unsigned long pc, b, f = 0, nblk = 0;
+  Block *blk;
+
+  if (!lead)
+    return 0;
+  for (b = 0; b < nfn; b++)
+    if (fn[b].start < n)
+      lead[fn[b].start] = 1;
+  for (pc = 0; pc < n; pc++)
+    nblk += lead[pc];
+  blk = (Block*)calloc(nblk + 1, sizeof(Block));
+  if (!blk) {
+    free(lead);
+    return 0;
+  }
+
+  for (pc = 0, b = 0; pc < n; pc++) {
+    if (lead[pc] && pc) {
+      blk[b++].end = pc;
+      blk[b].start = pc;
+    }
+    while (f + 1 < nfn && fn[f+1].start <= pc)
+      f++;
+    blk[b].fn = f;
+    bof[pc] = b;
+  }
+  if (n)
+    blk[b].end = n;
+  free(lead);
+
+  if (!find_loops(blk, nblk, bof, insts, n, fn)) {
+    free(blk);
+    return 0;
+  }
+  for (b = 0; b < nblk; b++) {
+    int d;
+    blk[b].mult = 1.0;
+    for (d = 0; d < blk[b].depth && d < MAXDEPTH; d++)
+      blk[b].mult *= loopw;
+  }
+  *out = blk;
+  return nblk;
+}
+
+
+int cost_file (char *prog, char *path)
+{
+  size_t sz = 0;
+  rvm_inst_t *insts;
+  unsigned long n, nfn, nblk = 0, pc, *bof;
+  Func *fn = NULL;
+  Block *blk = NULL;
+  DbgInfo di;
+  char *dpath, *mem;
+  int have_dbg;
+
+  mem = map_file(path, &sz);
+  if (!mem) {
+    printf("%s: Could not read file: %s\n\n", prog, path);
+    return 1;
+  }
+  insts = (rvm_inst_t*)(void*)mem;
+  n = sz >> 2;
+  load_defaults();
+
+  /* for function names */
+  dpath = (char*)malloc(strlen(path) + 5);
+  if (!dpath) {
+    unmap_file(mem, sz);
+    return 1;
+  }
+  sprintf(dpath, "%s.dbg", path);
+  have_dbg = dbg_load(&di, dpath);
+  free(dpath);
+
+  bof = (unsigned long*)malloc((n + 1) * sizeof(unsigned long));
+  nfn = bof ? find_funcs(&fn, insts, n, have_dbg ? &di : NULL) : 0;
+  if (nfn)
+    nblk = build_cfg(&blk, bof, insts, n, fn, nfn);
+  if (!nfn || (n && !nblk)) {
+    printf("%s: Out of memory\n", prog);
+    goto done;
+  }
+
+  for (pc = 0; pc < n; pc++) {
+    Block *b = &blk[bof[pc]];
+    Func *f = &fn[b->fn];
+    int opc = RVM_OPC(insts[pc]);
+    double c = weight[isa_index(opc)] * b->mult;
+    b->cost += c;
+    f->cost += c;
+    f->insts++;
+    f->blocks += b->start == pc;
+    if (isa_fmt(opc) == FMT_MEM)
+      f->mem += b->mult;
+  }
+  report(path, insts, n, fn, nfn, blk, nblk, bof);
+
+done:
+  free(blk);
+  free(fn);
+  free(bof);
+  if (have_dbg)
+    dbg_unload(&di);
+  unmap_file(mem, sz);
+  return 0;
+}
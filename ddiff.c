@@ -0,0 +1,387 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Structural diff of two images (--diff A B).
+ *
+ * Both images are split into basic blocks with isa_leaders(). Each
+ * block gets a base hash with the offsets of its pc-relative
+ * instructions cleared; its final hash adds, for every such
+ * instruction, the base hash of the block it lands in and the offset
+ * into it. Code that only moved hashes the same, a retarget does not.
+ * Blocks whose hash is unique in both images are anchors; the longest
+ * run of anchors in the same order on both sides (patience diff) fixes
+ * the alignment, and equal neighbours of matched blocks are matched
+ * outwards from there. What is left between two matches is paired up
+ * in order as changed blocks, and the excess on either side is added
+ * or removed.
+ *
+ * Everything is linear except the anchor ordering, which is
+ * O(k log k) in the number of anchors, and finding branch targets,
+ * O(log n) each.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rvm/rvm.h"
+#include "isa.h"
+#include "rvdis.h"
+#include "utils.h"
+
+typedef struct {
+  unsigned long start, end;  /* word indices, [start, end) */
+  unsigned long base;         /* with pc-relative offsets cleared */
+  unsigned long hash;         /* and their targets' base hashes added */
+  long peer;                 /* matched block on the other side, or -1 */
+} Block;
+
+typedef struct {
+  char *path, *mem;
+  size_t sz;
+  rvm_inst_t *insts;
+  Block *blk;
+  unsigned long n, nblk;
+} Image;
+
+/* hash index entry, keyed by block hash */
+typedef struct {
+  unsigned long hash;
+  unsigned long cnt[2];      /* blocks with this hash in A and B */
+  unsigned long idx[2];      /* the last of them */
+  int used;
+} Slot;
+
+#define FNV_BASIS  (2166136261ul)
+#define FNV_PRIME  (16777619ul)
+
+
+static unsigned long mix (unsigned long h, unsigned long v)
+{
+  int b;
+  for (b = 0; b < 32; b += 8) {
+    h ^= (v >> b) & 0xff;
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+
+static int is_pcrel (rvm_inst_t i)
+{
+  InstFmt fmt = isa_fmt(RVM_OPC(i));
+  return fmt == FMT_PC23 || fmt == FMT_RPC19;
+}
+
+
+static unsigned long hash_base (rvm_inst_t *insts, unsigned long start,
+                                unsigned long end)
+{
+  unsigned long h = FNV_BASIS, pc;
+  for (pc = start; pc < end; pc++) {
+    rvm_inst_t i = insts[pc];
+    if (is_pcrel(i)) {
+      InstInfo ii;
+      isa_decode(i, &ii);
+      ii.imms = 0;
+      i = isa_encode(&ii);
+    }
+    h = mix(h, i);
+  }
+  return h;
+}
+
+
+/* the block holding word `pc` */
+static unsigned long find_block (Image *im, unsigned long pc)
+{
+  unsigned long lo = 0, hi = im->nblk;
+  while (hi - lo > 1) {
+    unsigned long mid = (lo + hi) / 2;
+    if (im->blk[mid].start <= pc)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+
+static unsigned long hash_targets (Image *im, Block *bl)
+{
+  unsigned long h = bl->base, pc;
+  for (pc = bl->start; pc < bl->end; pc++) {
+    rvm_inst_t i = im->insts[pc];
+    long t;
+    if (!is_pcrel(i))
+      continue;
+    t = isa_target(pc, i);
+    if (t >= 0 && (unsigned long)t < im->n) {
+      Block *tb = &im->blk[find_block(im, (unsigned long)t)];
+      h = mix(h, tb->base);
+      h = mix(h, (unsigned long)t - tb->start);
+    }
+    else
+      h = mix(h, i);
+  }
+  return h;
+}
+
+
+static int load_image (Image *im, char *prog, char *path)
+{
+  unsigned char *lead;
+  unsigned long pc, b;
+
+  memset(im, 0, sizeof(Image));
+  im->path = path;
+  im->mem = map_file(path, &im->sz);
+  if (!im->mem) {
+    printf("%s: Could not read file: %s\n", prog, path);
+    return 0;
+  }
+  im->insts = (rvm_inst_t*)(void*)im->mem;
+  im->n = im->sz >> 2;
+
+  lead = isa_leaders(im->insts, im->n);
+  if (!lead)
+    goto nomem;
+  for (pc = 0; pc < im->n; pc++)
+    im->nblk += lead[pc];
+  im->blk = (Block*)malloc((im->nblk + 1) * sizeof(Block));
+  if (!im->blk) {
+    free(lead);
+    goto nomem;
+  }
+  for (pc = 0, b = 0; pc < im->n; pc++) {
+    if (lead[pc] && pc) {
+      im->blk[b++].end = pc;
+      im->blk[b].start = pc;
+    }
+  }
+  if (im->n) {
+    im->blk[0].start = 0;
+    im->blk[b].end = im->n;
+  }
+  free(lead);
+  for (b = 0; b < im->nblk; b++) {
+    im->blk[b].base = hash_base(im->insts, im->blk[b].start,
+                                im->blk[b].end);
+    im->blk[b].peer = -1;
+  }
+  for (b = 0; b < im->nblk; b++)
+    im->blk[b].hash = hash_targets(im, &im->blk[b]);
+  return 1;
+
+nomem:
+  printf("%s: Out of memory\n", prog);
+  unmap_file(im->mem, im->sz);
+  return 0;
+}
+
+
+static void free_image (Image *im)
+{
+  free(im->blk);
+  unmap_file(im->mem, im->sz);
+}
+
+
+static void link_blocks (Image *a, unsigned long i, Image *b,
+                         unsigned long j)
+{
+  a->blk[i].peer = (long)j;
+  b->blk[j].peer = (long)i;
+}
+
+
+/*
+ * Matches the blocks that are unique on both sides, keeping the
+ * longest subsequence that is in the same order in both.
+ */
+static int match_anchors (Image *a, Image *b)
+{
+  Image *im[2];
+  Slot *tab;
+  unsigned long size = 1, mask, s, k, nanc = 0, len = 0;
+  unsigned long *anc, *bj, *tail;
+  long *prev, t;
+  int side;
+
+  im[0] = a;
+  im[1] = b;
+  while (size < 2 * (a->nblk + b->nblk) + 1)
+    size <<= 1;
+  mask = size - 1;
+  tab = (Slot*)calloc(size, sizeof(Slot));
+  if (!tab)
+    return 0;
+  for (side = 0; side < 2; side++) {
+    for (k = 0; k < im[side]->nblk; k++) {
+      unsigned long h = im[side]->blk[k].hash;
+      for (s = h & mask; tab[s].used && tab[s].hash != h; s = (s+1) & mask)
+        ;;
+      tab[s].used = 1;
+      tab[s].hash = h;
+      tab[s].cnt[side]++;
+      tab[s].idx[side] = k;
+    }
+  }
+
+  /* anchors in A order, with their B index */
+  anc = (unsigned long*)malloc((2 * a->nblk + 1) * sizeof(unsigned long));
+  tail = (unsigned long*)malloc((a->nblk + 1) * sizeof(unsigned long));
+  prev = (long*)malloc((a->nblk + 1) * sizeof(long));
+  if (!anc || !tail || !prev) {
+    free(tab);
+    free(anc);
+    free(tail);
+    free(prev);
+    return 0;
+  }
+  bj = anc + a->nblk;
+  for (k = 0; k < a->nblk; k++) {
+    unsigned long h = a->blk[k].hash;
+    for (s = h & mask; tab[s].hash != h; s = (s+1) & mask)
+      ;;
+    if (tab[s].cnt[0] == 1 && tab[s].cnt[1] == 1) {
+      anc[nanc] = k;
+      bj[nanc++] = tab[s].idx[1];
+    }
+  }
+
+  /* longest increasing run of B indices, by its smallest tail per length */
+  for (k = 0; k < nanc; k++) {
+    unsigned long lo = 0, hi = len;
+    while (lo < hi) {
+      unsigned long mid = (lo + hi) / 2;
+      if (bj[tail[mid]] < bj[k])
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    prev[k] = lo ? (long)tail[lo-1] : -1;
+    tail[lo] = k;
+    if (lo == len)
+      len++;
+  }
+  for (t = len ? (long)tail[len-1] : -1; t >= 0; t = prev[t])
+    link_blocks(a, anc[t], b, bj[t]);
+
+  free(tab);
+  free(anc);
+  free(tail);
+  free(prev);
+  return 1;
+}
+
+
+/*
+ * Matches equal blocks next to matched ones, forwards and backwards.
+ */
+static void extend (Image *a, Image *b)
+{
+  unsigned long i, j = 0;
+  for (i = 0; i < a->nblk; i++) {
+    if (a->blk[i].peer >= 0)
+      j = (unsigned long)a->blk[i].peer + 1;
+    else if (j < b->nblk && b->blk[j].peer < 0 &&
+             a->blk[i].hash == b->blk[j].hash)
+      link_blocks(a, i, b, j++);
+    else
+      j = b->nblk;
+  }
+  j = b->nblk;
+  for (i = a->nblk; i-- > 0; ) {
+    if (a->blk[i].peer >= 0)
+      j = (unsigned long)a->blk[i].peer;
+    else if (j > 0 && j <= b->nblk && b->blk[j-1].peer < 0 &&
+             a->blk[i].hash == b->blk[j-1].hash)
+      link_blocks(a, i, b, --j);
+    else
+      j = 0;
+  }
+}
+
+
+static void print_block (char sign, Image *im, unsigned long k)
+{
+  unsigned long pc;
+  for (pc = im->blk[k].start; pc < im->blk[k].end; pc++) {
+    putc(sign, stdout);
+    print_inst(pc + 1, im->insts[pc]);
+  }
+}
+
+
+int diff_files (char *prog, char *path_a, char *path_b)
+{
+  Image a, b;
+  unsigned long i = 0, j = 0, same = 0, chg = 0, add = 0, del = 0;
+
+  if (!load_image(&a, prog, path_a))
+    return 2;
+  if (!load_image(&b, prog, path_b)) {
+    free_image(&a);
+    return 2;
+  }
+  if (!match_anchors(&a, &b)) {
+    printf("%s: Out of memory\n", prog);
+    free_image(&a);
+    free_image(&b);
+    return 2;
+  }
+  extend(&a, &b);
+
+  printf("--- %s\n+++ %s\n", path_a, path_b);
+  while (i < a.nblk || j < b.nblk) {
+    /* the unmatched runs up to the next match on each side */
+    unsigned long i1 = i, j1 = j;
+    while (i1 < a.nblk && a.blk[i1].peer < 0)
+      i1++;
+    while (j1 < b.nblk && b.blk[j1].peer < 0)
+      j1++;
+    for (; i < i1 && j < j1; i++, j++) {
+      printf("@@ changed %08lx %08lx @@\n", a.blk[i].start << 2,
+             b.blk[j].start << 2);
+      print_block('-', &a, i);
+      print_block('+', &b, j);
+      chg++;
+    }
+    for (; i < i1; i++, del++) {
+      printf("@@ removed %08lx @@\n", a.blk[i].start << 2);
+      print_block('-', &a, i);
+    }
+    for (; j < j1; j++, add++) {
+      printf("@@ added %08lx @@\n", b.blk[j].start << 2);
+      print_block('+', &b, j);
+    }
+    if (i < a.nblk && j < b.nblk) {
+      i++;
+      j++;
+      same++;
+    }
+  }
+  printf("\n%lu blocks equal, %lu changed, %lu added, %lu removed\n",
+         same, chg, add, del);
+
+  free_image(&a);
+  free_image(&b);
+  return chg || add || del;
+}
@@ -0,0 +1,156 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Structured decode output.
+ *
+ * NDJSON: one object per instruction:
+ *   {"pc":4,"raw":1015010852,"op":"j","opc":36,"fmt":"pc23",
+ *    "imms":-2,"immu":8388606,"target":0}
+ * Register keys ("ra", "rb", "rc") and the immediates appear only
+ * when the instruction has them. "target" is the byte address of
+ * pc-relative operands.
+ *
+ * Binary: a 16-byte header followed by fixed 24-byte records, all
+ * fields little-endian:
+ *
+ *   header:  0  char[4]  "RVDR"
+ *            4  u32      version (1)
+ *            8  u32      record size (24)
+ *           12  u32      record count
+ *
+ *   record:  0  u32      pc (byte address)
+ *            4  u32      raw instruction word
+ *            8  u16      opcode
+ *           10  u8       operand shape (InstFmt)
+ *           11  u8       rA (0xff if absent)
+ *           12  u8       rB (0xff if absent)
+ *           13  u8       rC (0xff if absent)
+ *           14  u8       immediate width in bits (0 if none)
+ *           15  u8       reserved (0)
+ *           16  i32      sign-extended immediate
+ *           20  u32      zero-extended immediate
+ */
+
+#include <stdio.h>
+
+#include "rvm/rvm.h"
+#include "isa.h"
+#include "rvdis.h"
+#include "utils.h"
+
+#define DUMP_VERSION  (1)
+#define DUMP_RECSZ    (24)
+
+static OutBuf out;
+
+
+static void put_reg (char *key, int r)
+{
+  if (r < 0)
+    return;
+  ob_puts(&out, key);
+  ob_putu(&out, (unsigned long)r);
+}
+
+
+static void ndjson_inst (unsigned long idx, rvm_inst_t i)
+{
+  InstInfo d;
+  isa_decode(i, &d);
+
+  ob_puts(&out, "{\"pc\":");
+  ob_putu(&out, idx << 2);
+  ob_puts(&out, ",\"raw\":");
+  ob_putu(&out, (unsigned long)i);
+  ob_puts(&out, ",\"op\":");
+  ob_jstr(&out, to_mnemonic(d.opc));
+  ob_puts(&out, ",\"opc\":");
+  ob_putu(&out, (unsigned long)d.opc);
+  ob_puts(&out, ",\"fmt\":\"");
+  ob_puts(&out, isa_fmtname(d.fmt));
+  ob_puts(&out, "\"");
+  put_reg(",\"ra\":", d.ra);
+  put_reg(",\"rb\":", d.rb);
+  put_reg(",\"rc\":", d.rc);
+  if (d.immbits) {
+    ob_puts(&out, ",\"imms\":");
+    ob_puti(&out, d.imms);
+    ob_puts(&out, ",\"immu\":");
+    ob_putu(&out, d.immu);
+  }
+  if (d.fmt == FMT_PC23 || d.fmt == FMT_RPC19) {
+    ob_puts(&out, ",\"target\":");
+    ob_puti(&out, isa_target(idx, i) * 4);
+  }
+  ob_puts(&out, "}\n");
+}
+
+
+static void bin_inst (unsigned long idx, rvm_inst_t i)
+{
+  InstInfo d;
+  isa_decode(i, &d);
+  ob_putle(&out, idx << 2, 4);
+  ob_putle(&out, (unsigned long)i, 4);
+  ob_putle(&out, (unsigned long)d.opc, 2);
+  ob_putle(&out, (unsigned long)d.fmt, 1);
+  ob_putle(&out, (unsigned long)(d.ra < 0 ? 0xff : d.ra), 1);
+  ob_putle(&out, (unsigned long)(d.rb < 0 ? 0xff : d.rb), 1);
+  ob_putle(&out, (unsigned long)(d.rc < 0 ? 0xff : d.rc), 1);
+  ob_putle(&out, (unsigned long)d.immbits, 1);
+  ob_putle(&out, 0, 1);
+  ob_putle(&out, (unsigned long)d.imms, 4);
+  ob_putle(&out, d.immu, 4);
+}
+
+
+int dump_file (char *prog, char *path, int binary)
+{
+  size_t sz = 0;
+  rvm_inst_t *insts;
+  unsigned long n, pc;
+  char *mem = map_file(path, &sz);
+  if (!mem) {
+    fprintf(stderr, "%s: Could not read file: %s\n", prog, path);
+    return 1;
+  }
+  insts = (rvm_inst_t*)(void*)mem;
+  n = sz >> 2;
+
+  ob_init(&out, stdout);
+  if (binary) {
+    ob_write(&out, "RVDR", 4);
+    ob_putle(&out, DUMP_VERSION, 4);
+    ob_putle(&out, DUMP_RECSZ, 4);
+    ob_putle(&out, n, 4);
+    for (pc = 0; pc < n; pc++)
+      bin_inst(pc, insts[pc]);
+  }
+  else {
+    for (pc = 0; pc < n; pc++)
+      ndjson_inst(pc, insts[pc]);
+  }
+
+  unmap_file(mem, sz);
+  if (ob_flush(&out)) {
+    fprintf(stderr, "%s: Write error\n", prog);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Make-compatible dependency files (-MD), listing every source file
+ * opened while assembling.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rvasm.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX  (4096)
+#endif
+
+
+/* make needs a backslash before a space or '#', and '$' doubled. */
+static void put_path (OutBuf *ob, char *s)
+{
+  for (; *s; s++) {
+    if (*s == ' ' || *s == '#')
+      ob_write(ob, "\\", 1);
+    else if (*s == '$')
+      ob_write(ob, "$", 1);
+    ob_write(ob, s, 1);
+  }
+}
+
+
+static int is_input (SrcFile *f, SrcFile **inputs, int ninputs)
+{
+  int i;
+  for (i = 0; i < ninputs; i++)
+    if (inputs[i] == f)
+      return 1;
+  return 0;
+}
+
+
+int deps_write (char *path, char *target, int phony, char **files,
+                int nfiles)
+{
+  static OutBuf ob;
+  char buf[PATH_MAX];
+  SrcFile *f, **seen, **inputs;
+  unsigned long n = 0, nseen = 0, i;
+  FILE *fp;
+  int ok, k;
+
+  for (f = src_list(); f; f = f->next)
+    n += src_used(f);
+  seen = (SrcFile**)calloc(n + 1, sizeof(SrcFile*));
+  inputs = (SrcFile**)calloc(nfiles + 1, sizeof(SrcFile*));
+  if (!seen || !inputs) {
+    free(seen);
+    free(inputs);
+    return 0;
+  }
+
+  /* canonical and deduplicated (by SrcFile), in load order */
+  for (f = src_list(); f; f = f->next)
+    if (src_used(f))
+      seen[nseen++] = f;
+  for (k = 0; k < nfiles; k++)
+    if (realpath(files[k], buf))
+      inputs[k] = src_bypath(buf);
+
+  fp = fopen(path, "w");
+  if (!fp) {
+    diag_msg("could not write dependency file: %s", path);
+    free(seen);
+    free(inputs);
+    return 0;
+  }
+  ob_init(&ob, fp);
+  put_path(&ob, target);
+  ob_puts(&ob, ":");
+  for (i = 0; i < nseen; i++) {
+    ob_puts(&ob, " \\\n  ");
+    put_path(&ob, seen[i]->path);
+  }
+  ob_puts(&ob, "\n");
+  /* -MP: keep make going when an include is deleted */
+  for (i = 0; phony && i < nseen; i++) {
+    if (is_input(seen[i], inputs, nfiles))
+      continue;
+    ob_puts(&ob, "\n");
+    put_path(&ob, seen[i]->path);
+    ob_puts(&ob, ":\n");
+  }
+  ok = !ob_flush(&ob);
+  ok = (fclose(fp) == 0) && ok;
+  if (!ok)
+    diag_msg("could not write dependency file: %s", path);
+  free(seen);
+  free(inputs);
+  return ok;
+}
@@ -0,0 +1,217 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Diagnostics are collected while assembling and written out in one
+ * go by diag_flush(), with source lines taken from the line index of
+ * each loaded file.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rvasm.h"
+
+typedef struct {
+  char   *fname;   /* NULL for messages without a location */
+  sloc_t  line, col, len;
+  size_t  msg;     /* offset into msgs */
+} Diag;
+
+static ByteBuf diags, msgs;
+static unsigned long ndiags = 0, nerrors = 0, limit = 0;
+
+
+void diag_init (unsigned long max_errors)
+{
+  bb_free(&diags);
+  bb_free(&msgs);
+  ndiags = nerrors = 0;
+  limit = max_errors;
+}
+
+
+unsigned long diag_errors (void)
+{
+  return nerrors;
+}
+
+
+int diag_full (void)
+{
+  return limit && nerrors >= limit;
+}
+
+
+static void vrecord (char *fname, sloc_t line, sloc_t col, sloc_t len,
+                     char *fmt, va_list ap)
+{
+  char buf[512];
+  Diag d;
+  int n;
+  nerrors++;
+  if (limit && nerrors > limit)
+    return;
+  n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  if (n < 0)
+    n = 0;
+  if ((size_t)n >= sizeof(buf))
+    n = sizeof(buf) - 1;
+  d.fname = fname;
+  d.line = line;
+  d.col = col;
+  d.len = len;
+  d.msg = msgs.len;
+  bb_write(&msgs, buf, n);
+  bb_write(&msgs, "", 1);
+  bb_write(&diags, &d, sizeof(d));
+  ndiags++;
+}
+
+
+void diag_tok (Token *tok, char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vrecord(tok->fname, tok->line, tok->col, tok->len, fmt, ap);
+  va_end(ap);
+}
+
+
+void diag_at (char *fname, sloc_t line, sloc_t col, sloc_t len,
+              char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vrecord(fname, line, col, len, fmt, ap);
+  va_end(ap);
+}
+
+
+void diag_msg (char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vrecord(NULL, 0, 0, 0, fmt, ap);
+  va_end(ap);
+}
+
+
+static void put_num (ByteBuf *bb, unsigned long v, int width)
+{
+  char tmp[24];
+  int n = 0;
+  do {
+    tmp[sizeof(tmp) - ++n] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  for (; width > n; width--)
+    bb_write(bb, " ", 1);
+  bb_write(bb, &tmp[sizeof(tmp) - n], n);
+}
+
+
+static void put_spaces (ByteBuf *bb, sloc_t n)
+{
+  static const char sp[] = "                                ";
+  while (n) {
+    sloc_t k = n < sizeof(sp) - 1 ? n : sizeof(sp) - 1;
+    bb_write(bb, sp, k);
+    n -= k;
+  }
+}
+
+
+/*
+ *   file:line:col: error: message
+ *      12 | source line, tabs expanded
+ *         |     ^^^^
+ */
+static void format_diag (ByteBuf *bb, Diag *d)
+{
+  SrcFile *f;
+  char *text;
+  size_t len = 0, i;
+  sloc_t col = 1;
+
+  if (!d->fname) {
+    bb_write(bb, "error: ", 7);
+    bb_write(bb, &msgs.data[d->msg], strlen(&msgs.data[d->msg]));
+    bb_write(bb, "\n", 1);
+    return;
+  }
+  bb_write(bb, d->fname, strlen(d->fname));
+  bb_write(bb, ":", 1);
+  put_num(bb, d->line, 0);
+  bb_write(bb, ":", 1);
+  put_num(bb, d->col, 0);
+  bb_write(bb, ": error: ", 9);
+  bb_write(bb, &msgs.data[d->msg], strlen(&msgs.data[d->msg]));
+  bb_write(bb, "\n", 1);
+
+  f = src_find(d->fname);
+  text = f ? src_line(f, d->line, &len) : NULL;
+  if (!text)
+    return;
+  put_num(bb, d->line, 5);
+  bb_write(bb, " | ", 3);
+  for (i = 0; i < len; i++) {
+    if (text[i] == '\t') {
+      sloc_t w = TABSTOP - ((col-1) % TABSTOP);
+      put_spaces(bb, w);
+      col += w;
+    }
+    else {
+      bb_write(bb, &text[i], 1);
+      col++;
+    }
+  }
+  bb_write(bb, "\n      | ", 9);
+  put_spaces(bb, d->col - 1);
+  for (i = 0; i < (d->len ? d->len : 1); i++)
+    bb_write(bb, "^", 1);
+  bb_write(bb, "\n", 1);
+}
+
+
+int diag_flush (FILE *fp)
+{
+  ByteBuf out;
+  Diag *d = (Diag*)(void*)diags.data;
+  unsigned long i;
+  int ok = 1;
+
+  if (!nerrors)
+    return 1;
+  bb_init(&out);
+  for (i = 0; i < ndiags; i++)
+    format_diag(&out, &d[i]);
+  if (diag_full()) {
+    static const char msg[] = "error: too many errors, stopping\n";
+    bb_write(&out, msg, sizeof(msg) - 1);
+  }
+  if (out.len && fwrite(out.data, 1, out.len, fp) != out.len)
+    ok = 0;
+  fflush(fp);
+  bb_free(&out);
+  diag_init(limit);
+  return ok;
+}
@@ -0,0 +1,241 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reader for the `.dbg` sidecar written by `rvasm -g` (see dbg.c).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rvm/rvm.h"
+#include "rvdis.h"
+#include "utils.h"
+
+
+static const unsigned char *get_str (const unsigned char **p,
+                                     const unsigned char *end,
+                                     unsigned long *len)
+{
+  const unsigned char *s;
+  *len = rd_uleb(p, end);
+  if (*len > (unsigned long)(end - *p))
+    return NULL;
+  s = *p;
+  *p += *len;
+  return s;
+}
+
+
+static char *dup_str (const unsigned char *s, unsigned long len)
+{
+  char *d = (char*)malloc(len + 1);
+  if (!d)
+    return NULL;
+  memcpy(d, s, len);
+  d[len] = '\0';
+  return d;
+}
+
+
+static int sym_cmp (const void *a, const void *b)
+{
+  const DbgSym *x = (const DbgSym*)a, *y = (const DbgSym*)b;
+  return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+
+void dbg_unload (DbgInfo *di)
+{
+  unsigned long i;
+  for (i = 0; i < di->nfiles; i++) {
+    free(di->files[i].name);
+    free(di->files[i].text);
+    free(di->files[i].lines);
+  }
+  for (i = 0; i < di->nsyms; i++)
+    free(di->syms[i].name);
+  free(di->files);
+  free(di->syms);
+  free(di->rows);
+  memset(di, 0, sizeof(*di));
+}
+
+
+int dbg_load (DbgInfo *di, char *path)
+{
+  size_t sz = 0;
+  const unsigned char *p, *end, *s;
+  unsigned long i, len, pc = 0, file = 0;
+  long line = 0;
+  char *mem;
+
+  memset(di, 0, sizeof(*di));
+  mem = read_bin_file(path, &sz);
+  if (!mem)
+    return 0;
+  p = (const unsigned char*)mem;
+  end = p + sz;
+  if (sz < 5 || memcmp(p, "RVDG", 4) != 0 || p[4] != 1)
+    goto bad;
+  p += 5;
+
+  di->nfiles = rd_uleb(&p, end);
+  if (di->nfiles > sz)
+    goto bad;
+  di->files = (DbgFile*)calloc(di->nfiles + 1, sizeof(DbgFile));
+  if (!di->files)
+    goto bad;
+  for (i = 0; i < di->nfiles; i++) {
+    if (!(s = get_str(&p, end, &len)) ||
+        !(di->files[i].name = dup_str(s, len)))
+      goto bad;
+  }
+
+  di->nsyms = rd_uleb(&p, end);
+  if (di->nsyms > sz)
+    goto bad;
+  di->syms = (DbgSym*)calloc(di->nsyms + 1, sizeof(DbgSym));
+  if (!di->syms)
+    goto bad;
+  for (i = 0; i < di->nsyms; i++) {
+    di->syms[i].addr = rd_uleb(&p, end);
+    if (!(s = get_str(&p, end, &len)) ||
+        !(di->syms[i].name = dup_str(s, len)))
+      goto bad;
+  }
+  qsort(di->syms, di->nsyms, sizeof(DbgSym), sym_cmp);
+
+  di->nrows = rd_uleb(&p, end);
+  if (di->nrows > sz)
+    goto bad;
+  di->rows = (DbgRow*)calloc(di->nrows + 1, sizeof(DbgRow));
+  if (!di->rows)
+    goto bad;
+  for (i = 0; i < di->nrows; i++) {
+    unsigned long d = rd_uleb(&p, end);
+    pc += d >> 1;
+    if (d & 1)
+      file = rd_uleb(&p, end);
+    line += rd_sleb(&p, end);
+    if (file >= di->nfiles)
+      goto bad;
+    di->rows[i].pc = pc;
+    di->rows[i].file = file;
+    di->rows[i].line = (unsigned long)line;
+  }
+
+  free(mem);
+  return 1;
+
+bad:
+  free(mem);
+  dbg_unload(di);
+  return 0;
+}
+
+
+long dbg_find (DbgInfo *di, unsigned long pc)
+{
+  long lo = 0, hi = (long)di->nrows - 1, found = -1;
+  while (lo <= hi) {
+    long mid = lo + (hi - lo) / 2;
+    if (di->rows[mid].pc <= pc) {
+      found = mid;
+      lo = mid + 1;
+    }
+    else
+      hi = mid - 1;
+  }
+  return found;
+}
+
+
+/*
+ * Index the start of each line on first use.
+ */
+static char *src_line (DbgFile *f, unsigned long line, size_t *len)
+{
+  if (!f->lines) {
+    size_t sz = 0;
+    if (f->failed || !(f->text = read_ascii_file(f->name, &sz)) ||
+        !(f->lines = line_index(f->text, sz, &f->nlines))) {
+      f->failed = 1;
+      return NULL;
+    }
+  }
+  return line_get(f->text, f->lines, f->nlines, line, len);
+}
+
+
+int source_file (char *prog, char *path)
+{
+  size_t sz = 0;
+  rvm_inst_t *insts;
+  unsigned long n, pc, k = 0;
+  long row, last = -1;
+  DbgInfo di;
+  char *dpath, *mem;
+
+  dpath = (char*)malloc(strlen(path) + 5);
+  if (!dpath)
+    return 1;
+  sprintf(dpath, "%s.dbg", path);
+  if (!dbg_load(&di, dpath)) {
+    printf("%s: Could not read debug info: %s\n\n", prog, dpath);
+    free(dpath);
+    return 1;
+  }
+  free(dpath);
+
+  mem = map_file(path, &sz);
+  if (!mem) {
+    printf("%s: Could not read file: %s\n\n", prog, path);
+    dbg_unload(&di);
+    return 1;
+  }
+  printf("Disassembly of file:    %s\n\n", path);
+  insts = (rvm_inst_t*)(void*)mem;
+  n = sz >> 2;
+
+  for (pc = 0; pc < n; pc++) {
+    for (; k < di.nsyms && di.syms[k].addr <= (pc << 2); k++)
+      if (di.syms[k].addr == (pc << 2))
+        printf("\n%08lx <%s>:\n", pc << 2, di.syms[k].name);
+
+    row = dbg_find(&di, pc);
+    if (row >= 0 && row != last) {
+      DbgRow *r = &di.rows[row];
+      DbgFile *f = &di.files[r->file];
+      size_t len = 0;
+      char *text = src_line(f, r->line, &len);
+      printf("%s:%lu:\t", f->name, r->line);
+      if (text)
+        fwrite(text, 1, len, stdout);
+      putc('\n', stdout);
+      last = row;
+    }
+    print_inst(pc+1, insts[pc]);
+  }
+  putc('\n', stdout);
+
+  unmap_file(mem, sz);
+  dbg_unload(&di);
+  return 0;
+}
@@ -0,0 +1,362 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rvm/rvm.h"
+#include "isa.h"
+#include "rvdis.h"
+#include "utils.h"
+
+#define NIDX    (ISA_NOPS + 1)  /* known opcodes + .raw */
+#define NREGS   (32)
+#define TOPN    (16)
+#define NBLKBKT (24)
+#define NOPC    (RVM_OPC(~0ul) + 1)
+
+typedef struct {
+  unsigned long cnt;
+  int seq[3];
+} NGram;
+
+typedef struct {
+  unsigned long hist[NIDX];
+  unsigned long regs[NREGS][3];
+  unsigned long f11[12], f15[16], f19[20], f23[24], trap[9];
+  unsigned long blocks, blklen[NBLKBKT];
+  unsigned long *pairs, *triples;
+  unsigned char idx[NOPC], fmt[NOPC];
+} Stats;
+
+static OutBuf out;
+
+
+static int uwidth (unsigned long v)
+{
+  int w = 0;
+  while (v) {
+    w++;
+    v >>= 1;
+  }
+  return w;
+}
+
+
+/* bits needed to hold `v` in two's complement, 0 for zero. */
+static int swidth (long v)
+{
+  if (v < 0)
+    return uwidth(~(unsigned long)v) + 1;
+  return v ? uwidth((unsigned long)v) + 1 : 0;
+}
+
+
+static char *idx_name (int idx)
+{
+  return to_mnemonic(isa_opcode(idx));
+}
+
+
+static void print_arr (unsigned long *a, int n)
+{
+  int i;
+  ob_puts(&out, "[");
+  for (i = 0; i < n; i++) {
+    if (i)
+      ob_puts(&out, ", ");
+    ob_putu(&out, a[i]);
+  }
+  ob_puts(&out, "]");
+}
+
+
+/*
+ * Keep the `TOPN` most frequent n-grams, sorted by count.
+ */
+static void top_add (NGram *top, int *ntop, unsigned long cnt,
+                     int a, int b, int c)
+{
+  int i;
+  if (!cnt || (*ntop == TOPN && top[TOPN-1].cnt >= cnt))
+    return;
+  i = *ntop < TOPN ? (*ntop)++ : TOPN - 1;
+  for (; i > 0 && top[i-1].cnt < cnt; i--)
+    top[i] = top[i-1];
+  top[i].cnt = cnt;
+  top[i].seq[0] = a;
+  top[i].seq[1] = b;
+  top[i].seq[2] = c;
+}
+
+
+static void print_top (NGram *top, int ntop, int len)
+{
+  int i, j;
+  ob_puts(&out, "[");
+  for (i = 0; i < ntop; i++) {
+    ob_puts(&out, i ? ",\n    {\"seq\": [" : "\n    {\"seq\": [");
+    for (j = 0; j < len; j++) {
+      if (j)
+        ob_puts(&out, ", ");
+      ob_jstr(&out, idx_name(top[i].seq[j]));
+    }
+    ob_puts(&out, "], \"count\": ");
+    ob_putu(&out, top[i].cnt);
+    ob_puts(&out, "}");
+  }
+  ob_puts(&out, ntop ? "\n  ]" : "]");
+}
+
+
+/*
+ * Opcode to dense index and format, so the hot loop below does two
+ * table loads per instruction instead of two switches.
+ */
+static void build_tables (Stats *st)
+{
+  int opc;
+  for (opc = 0; opc < NOPC; opc++) {
+    st->idx[opc] = (unsigned char)isa_index(opc);
+    st->fmt[opc] = (unsigned char)isa_fmt(opc);
+  }
+}
+
+
+/*
+ * The hot loop. Opcode lookups go through the tables above, so this
+ * runs close to memory bandwidth over the mapped image. N-grams don't
+ * cross block leaders, so they are sequences that always run together.
+ */
+static void collect (Stats *st, rvm_inst_t *insts, unsigned char *lead,
+                     unsigned long n)
+{
+  unsigned long pc;
+  int p1 = -1, p2 = -1;
+
+  for (pc = 0; pc < n; pc++) {
+    rvm_inst_t i = insts[pc];
+    int opc = RVM_OPC(i);
+    int idx = st->idx[opc];
+    unsigned long fnc = RVM_FNC(i);
+
+    st->hist[idx]++;
+    if (lead[pc])
+      p1 = p2 = -1;
+    if (p1 >= 0) {
+      st->pairs[p1 * NIDX + idx]++;
+      if (p2 >= 0)
+        st->triples[(p2 * NIDX + p1) * NIDX + idx]++;
+    }
+    p2 = p1;
+    p1 = idx;
+
+    switch ((InstFmt)st->fmt[opc]) {
+      case FMT_NONE:
+      case FMT_RAW:
+        break;
+      case FMT_TRAP:
+        st->trap[uwidth(fnc & 0xff)]++;
+        break;
+      case FMT_PC23:
+        st->f23[swidth(RVM_SGXTD(fnc & RVM_F23MASK, 23))]++;
+        break;
+      case FMT_R:
+        st->regs[RVM_RGA(i) % NREGS][0]++;
+        break;
+      case FMT_RI19:
+      case FMT_RPC19:
+        st->regs[RVM_RGA(i) % NREGS][0]++;
+        st->f19[swidth(RVM_SGXTD(fnc & RVM_F19MASK, 19))]++;
+        break;
+      case FMT_RR:
+        st->regs[RVM_RGA(i) % NREGS][0]++;
+        st->regs[RVM_RGB(i) % NREGS][1]++;
+        break;
+      case FMT_RRI15:
+      case FMT_MEM:
+        st->regs[RVM_RGA(i) % NREGS][0]++;
+        st->regs[RVM_RGB(i) % NREGS][1]++;
+        st->f15[swidth(RVM_SGXTD(fnc & RVM_F15MASK, 15))]++;
+        break;
+      case FMT_RRR:
+        st->regs[RVM_RGA(i) % NREGS][0]++;
+        st->regs[RVM_RGB(i) % NREGS][1]++;
+        st->regs[RVM_RGC(i) % NREGS][2]++;
+        st->f11[uwidth(fnc & RVM_F11MASK)]++;
+        break;
+    }
+  }
+}
+
+
+static void collect_blocks (Stats *st, unsigned char *lead, unsigned long n)
+{
+  unsigned long pc, len = 0;
+  for (pc = 0; pc <= n; pc++) {
+    if ((pc == n || lead[pc]) && len) {
+      int b = uwidth(len) - 1;
+      st->blklen[b < NBLKBKT ? b : NBLKBKT-1]++;
+      st->blocks++;
+      len = 0;
+    }
+    len++;
+  }
+}
+
+
+static void print_imm (const char *key, unsigned long *a, int n)
+{
+  ob_puts(&out, key);
+  print_arr(a, n);
+}
+
+
+static void print_stats (Stats *st, char *path, unsigned long n)
+{
+  NGram top[TOPN];
+  int ntop, a, b, c, r;
+
+  ob_puts(&out, "{\n  \"file\": ");
+  ob_jstr(&out, path);
+  ob_puts(&out, ",\n  \"insts\": ");
+  ob_putu(&out, n);
+  ob_puts(&out, ",\n");
+
+  ob_puts(&out, "  \"opcodes\": {");
+  for (a = 0, c = 0; a < NIDX; a++) {
+    if (!st->hist[a])
+      continue;
+    if (c++)
+      ob_puts(&out, ", ");
+    ob_jstr(&out, idx_name(a));
+    ob_puts(&out, ": ");
+    ob_putu(&out, st->hist[a]);
+  }
+  ob_puts(&out, "},\n");
+
+  ob_puts(&out, "  \"registers\": {");
+  for (r = 0, c = 0; r < NREGS; r++) {
+    if (!st->regs[r][0] && !st->regs[r][1] && !st->regs[r][2])
+      continue;
+    if (c++)
+      ob_puts(&out, ", ");
+    if (r == RVM_RSP)
+      ob_puts(&out, "\"sp\": ");
+    else {
+      ob_puts(&out, "\"r");
+      ob_putu(&out, (unsigned long)r);
+      ob_puts(&out, "\": ");
+    }
+    print_arr(st->regs[r], 3);
+  }
+  ob_puts(&out, "},\n");
+
+  print_imm("  \"immediates\": {\"f11\": ", st->f11, 12);
+  print_imm(", \"f15\": ", st->f15, 16);
+  print_imm(", \"f19\": ", st->f19, 20);
+  print_imm(", \"f23\": ", st->f23, 24);
+  print_imm(", \"trap\": ", st->trap, 9);
+  ob_puts(&out, "},\n");
+
+  ntop = 0;
+  for (a = 0; a < NIDX; a++)
+    for (b = 0; b < NIDX; b++)
+      top_add(top, &ntop, st->pairs[a * NIDX + b], a, b, 0);
+  ob_puts(&out, "  \"pairs\": ");
+  print_top(top, ntop, 2);
+  ob_puts(&out, ",\n");
+
+  ntop = 0;
+  for (a = 0; a < NIDX; a++)
+    for (b = 0; b < NIDX; b++)
+      for (c = 0; c < NIDX; c++)
+        top_add(top, &ntop, st->triples[(a * NIDX + b) * NIDX + c],
+                a, b, c);
+  ob_puts(&out, "  \"triples\": ");
+  print_top(top, ntop, 3);
+  ob_puts(&out, ",\n");
+
+  ob_puts(&out, "  \"blocks\": {\"count\": ");
+  ob_putu(&out, st->blocks);
+  ob_puts(&out, ", \"lengths\": {");
+  for (a = 0, c = 0; a < NBLKBKT; a++) {
+    if (!st->blklen[a])
+      continue;
+    if (c++)
+      ob_puts(&out, ", ");
+    ob_puts(&out, "\"");
+    ob_putu(&out, 1ul << a);
+    if (a) {
+      ob_puts(&out, "-");
+      ob_putu(&out, (2ul << a) - 1);
+    }
+    ob_puts(&out, "\": ");
+    ob_putu(&out, st->blklen[a]);
+  }
+  ob_puts(&out, "}}\n}\n");
+}
+
+
+int stats_file (char *prog, char *path)
+{
+  size_t sz = 0;
+  unsigned long n;
+  unsigned char *lead;
+  Stats *st;
+  char *mem = map_file(path, &sz);
+  if (!mem) {
+    printf("%s: Could not read file: %s\n\n", prog, path);
+    return 1;
+  }
+  n = sz >> 2;
+
+  st = (Stats*)calloc(1, sizeof(Stats));
+  if (st) {
+    st->pairs = (unsigned long*)calloc(NIDX * NIDX, sizeof(unsigned long));
+    st->triples = (unsigned long*)calloc((size_t)NIDX * NIDX * NIDX,
+                                         sizeof(unsigned long));
+  }
+  lead = isa_leaders((rvm_inst_t*)(void*)mem, n);
+  if (!st || !st->pairs || !st->triples || !lead) {
+    printf("%s: Out of memory\n", prog);
+    if (st) {
+      free(st->pairs);
+      free(st->triples);
+    }
+    free(st);
+    free(lead);
+    unmap_file(mem, sz);
+    return 1;
+  }
+
+  build_tables(st);
+  collect(st, (rvm_inst_t*)(void*)mem, lead, n);
+  collect_blocks(st, lead, n);
+  ob_init(&out, stdout);
+  print_stats(st, path, n);
+  ob_flush(&out);
+
+  free(lead);
+  free(st->pairs);
+  free(st->triples);
+  free(st);
+  unmap_file(mem, sz);
+  return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Fuzz target: rvdis's print_inst() and the isa helpers, over every
+ * word of the input.
+ */
+
+#include <stdio.h>
+
+#include "../isa.h"
+#include "../rvdis.h"
+
+int LLVMFuzzerTestOneInput (const unsigned char *data, size_t size);
+
+
+int LLVMFuzzerTestOneInput (const unsigned char *data, size_t size)
+{
+  static int init = 0;
+  unsigned long pc, n = size / sizeof(rvm_inst_t);
+
+  if (!init) {
+    init = 1;
+    if (!freopen("/dev/null", "w", stdout))
+      return 0;
+  }
+  for (pc = 0; pc < n; pc++) {
+    rvm_inst_t i = 0;
+    InstInfo in;
+    size_t k;
+    for (k = 0; k < sizeof(rvm_inst_t); k++)
+      i |= (rvm_inst_t)data[pc*sizeof(rvm_inst_t) + k] << (8*k);
+    print_inst(pc, i);
+    isa_decode(i, &in);
+    isa_encode(&in);
+    if (isa_isbranch(in.opc))
+      isa_target(pc, i);
+  }
+  return 0;
+}
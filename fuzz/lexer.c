@@ -0,0 +1,64 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Fuzz target: the lexer, with lookahead and string decoding.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../rvasm.h"
+
+int LLVMFuzzerTestOneInput (const unsigned char *data, size_t size);
+
+
+int LLVMFuzzerTestOneInput (const unsigned char *data, size_t size)
+{
+  Lexer l;
+  char *src, *str;
+  unsigned long n = 0;
+
+  /* the lexer expects NUL-terminated text */
+  src = (char*)malloc(size + 1);
+  str = (char*)malloc(size + 1);
+  if (!src || !str) {
+    free(src);
+    free(str);
+    return 0;
+  }
+  memcpy(src, data, size);
+  src[size] = '\0';
+
+  lex_init(&l, src, "fuzz");
+  while (lex_isact(&l)) {
+    Token *tok;
+    /* every other token comes through the lookahead */
+    if (n++ & 1)
+      lex_peek(&l);
+    tok = lex_next(&l);
+    if (tok->tt == TK_STR)
+      lex_str(tok, str);
+    /* each token consumes input, so this bounds the loop */
+    if (n > size + 2)
+      abort();
+  }
+  free(src);
+  free(str);
+  return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Standalone driver for the fuzz targets, for AFL and for replaying
+ * crashes without libFuzzer. Runs each file given, or stdin.
+ *
+ *   make fuzz FUZZ-CC=afl-clang-fast FUZZ-FLAGS= FUZZ-MAIN=fuzz/main.c
+ *   afl-fuzz -i SEEDS -o out -- fuzz/parser @@
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* the targets are built with -Dmain=... */
+#undef main
+
+int LLVMFuzzerTestOneInput (const unsigned char *data, size_t size);
+
+
+static int run (FILE *fp)
+{
+  unsigned char *buf = NULL, *nbuf;
+  size_t len = 0, cap = 0, n;
+  do {
+    if (len == cap) {
+      cap = cap ? cap * 2 : 4096;
+      nbuf = (unsigned char*)realloc(buf, cap);
+      if (!nbuf) {
+        free(buf);
+        return 1;
+      }
+      buf = nbuf;
+    }
+    n = fread(buf + len, 1, cap - len, fp);
+    len += n;
+  } while (n);
+  LLVMFuzzerTestOneInput(buf, len);
+  free(buf);
+  return 0;
+}
+
+
+int main (int argc, char **argv)
+{
+  int i, rc = 0;
+  if (argc < 2)
+    return run(stdin);
+  for (i = 1; i < argc; i++) {
+    FILE *fp = fopen(argv[i], "rb");
+    if (!fp) {
+      perror(argv[i]);
+      rc = 1;
+      continue;
+    }
+    rc |= run(fp);
+    fclose(fp);
+  }
+  return rc;
+}
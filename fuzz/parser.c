@@ -0,0 +1,74 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Fuzz target: the whole front end, parse, --gc-sections, layout and
+ * encoding, without writing an image. The input goes through a scratch
+ * file since sources are loaded by path.
+ *
+ * Built with RVASM_FUZZING (see rvasm.h), so inputs like `.rept
+ * 2000000000` or `.include "/dev/zero"` fail fast instead of being
+ * reported as timeouts.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../rvasm.h"
+
+int LLVMFuzzerTestOneInput (const unsigned char *data, size_t size);
+
+static char path[] = "/tmp/rvasm-fuzz-XXXXXX";
+static int fd = -1;
+
+
+static void cleanup (void)
+{
+  unlink(path);
+}
+
+
+int LLVMFuzzerTestOneInput (const unsigned char *data, size_t size)
+{
+  if (fd < 0) {
+    fd = mkstemp(path);
+    if (fd < 0)
+      abort();
+    atexit(cleanup);
+    glob_mem = arena_new(0);
+  }
+  if (ftruncate(fd, 0) != 0 || pwrite(fd, data, size, 0) != (ssize_t)size)
+    abort();
+
+  arena_reset(glob_mem);
+  src_begin();
+  diag_init(DEFMAXERRS);
+  ir_init();
+  sym_init();
+  if (rvasm_parse(path) && rvasm_gc(NULL, NULL)) {
+    rvasm_layout();
+    rvasm_encode(NULL);
+  }
+  ir_free();
+  /* sources are cached by path, and the next input reuses it */
+  src_free();
+  return 0;
+}
@@ -0,0 +1,324 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "rvm/rvm.h"
+#include "isa.h"
+
+
+char *to_mnemonic (int op)
+{
+  switch (op) {
+#define DEF(op, idx) case (idx): return #op ;
+#include "rvm/opcodes.h"
+#undef DEF
+  default: return ".raw";
+  }
+}
+
+
+InstFmt isa_fmt (int op)
+{
+  switch (op) {
+    case RVM_OP_nop:
+    case RVM_OP_ret:
+      return FMT_NONE;
+
+    case RVM_OP_mov:
+    case RVM_OP_cmp:
+    case RVM_OP_cpl:
+    case RVM_OP_neg:
+    case RVM_OP_swp:
+      return FMT_RR;
+
+    case RVM_OP_trap:
+      return FMT_TRAP;
+
+    case RVM_OP_li:
+    case RVM_OP_cmpi:
+      return FMT_RI19;
+
+    case RVM_OP_adr:
+    case RVM_OP_loop:
+      return FMT_RPC19;
+
+    case RVM_OP_j:
+    case RVM_OP_je:
+    case RVM_OP_jne:
+    case RVM_OP_jg:
+    case RVM_OP_ja:
+    case RVM_OP_jl:
+    case RVM_OP_jb:
+    case RVM_OP_jge:
+    case RVM_OP_jae:
+    case RVM_OP_jle:
+    case RVM_OP_jbe:
+    case RVM_OP_call:
+      return FMT_PC23;
+
+    case RVM_OP_inc:
+    case RVM_OP_dec:
+    case RVM_OP_jr:
+    case RVM_OP_callr:
+      return FMT_R;
+
+    case RVM_OP_add:
+    case RVM_OP_sub:
+    case RVM_OP_mul:
+    case RVM_OP_div:
+    case RVM_OP_mod:
+    case RVM_OP_muls:
+    case RVM_OP_divs:
+    case RVM_OP_and:
+    case RVM_OP_orr:
+    case RVM_OP_xor:
+    case RVM_OP_shl:
+    case RVM_OP_shr:
+      return FMT_RRR;
+
+    case RVM_OP_addi:
+    case RVM_OP_subi:
+    case RVM_OP_muli:
+    case RVM_OP_divi:
+    case RVM_OP_modi:
+    case RVM_OP_mulsi:
+    case RVM_OP_divsi:
+    case RVM_OP_andi:
+    case RVM_OP_orri:
+    case RVM_OP_xori:
+    case RVM_OP_shli:
+    case RVM_OP_shri:
+      return FMT_RRI15;
+
+    case RVM_OP_rd8:
+    case RVM_OP_wr8:
+    case RVM_OP_rd16:
+    case RVM_OP_wr16:
+    case RVM_OP_rd32:
+    case RVM_OP_wr32:
+    case RVM_OP_rd64:
+    case RVM_OP_wr64:
+      return FMT_MEM;
+  }
+  return FMT_RAW;
+}
+
+
+char *isa_fmtname (InstFmt fmt)
+{
+  switch (fmt) {
+    case FMT_NONE:  return "none";
+    case FMT_RR:    return "rr";
+    case FMT_TRAP:  return "trap";
+    case FMT_RI19:  return "ri19";
+    case FMT_RPC19: return "rpc19";
+    case FMT_PC23:  return "pc23";
+    case FMT_R:     return "r";
+    case FMT_RRR:   return "rrr";
+    case FMT_RRI15: return "rri15";
+    case FMT_MEM:   return "mem";
+    default:        return "raw";
+  }
+}
+
+
+void isa_decode (rvm_inst_t i, InstInfo *out)
+{
+  unsigned long fnc = RVM_FNC(i);
+  out->opc = RVM_OPC(i);
+  out->fmt = isa_fmt(out->opc);
+  out->ra = out->rb = out->rc = -1;
+  out->immbits = 0;
+
+  switch (out->fmt) {
+    case FMT_RRR:
+      out->rc = RVM_RGC(i);
+      out->immbits = 11;
+      fnc &= RVM_F11MASK;
+      /* fallthrough */
+    case FMT_RR:
+      out->rb = RVM_RGB(i);
+      out->ra = RVM_RGA(i);
+      break;
+    case FMT_RRI15:
+    case FMT_MEM:
+      out->ra = RVM_RGA(i);
+      out->rb = RVM_RGB(i);
+      out->immbits = 15;
+      fnc &= RVM_F15MASK;
+      break;
+    case FMT_RI19:
+    case FMT_RPC19:
+      out->ra = RVM_RGA(i);
+      out->immbits = 19;
+      fnc &= RVM_F19MASK;
+      break;
+    case FMT_R:
+      out->ra = RVM_RGA(i);
+      break;
+    case FMT_PC23:
+      out->immbits = 23;
+      fnc &= RVM_F23MASK;
+      break;
+    case FMT_TRAP:
+      out->immbits = 8;
+      fnc &= 0xff;
+      break;
+    default:
+      break;
+  }
+
+  if (out->immbits) {
+    out->immu = fnc;
+    out->imms = (long)RVM_SGXTD(fnc, out->immbits);
+  }
+  else {
+    out->immu = 0;
+    out->imms = 0;
+  }
+}
+
+
+int isa_immbits (InstFmt fmt)
+{
+  switch (fmt) {
+    case FMT_RRR:   return 11;
+    case FMT_RRI15:
+    case FMT_MEM:   return 15;
+    case FMT_RI19:
+    case FMT_RPC19: return 19;
+    case FMT_PC23:  return 23;
+    case FMT_TRAP:  return 8;
+    default:        return 0;
+  }
+}
+
+
+/* bit positions of each field, found by probing the decode macros so
+   the encoder always agrees with rvm/rvm.h. */
+static int sh_opc = -1, sh_rga, sh_rgb, sh_rgc, sh_fnc;
+
+static void probe_fields (void)
+{
+  int b;
+  sh_opc = sh_rga = sh_rgb = sh_rgc = sh_fnc = 0;
+  for (b = 31; b >= 0; b--) {
+    rvm_inst_t bit = (rvm_inst_t)1 << b;
+    if (RVM_OPC(bit)) sh_opc = b;
+    if (RVM_RGA(bit)) sh_rga = b;
+    if (RVM_RGB(bit)) sh_rgb = b;
+    if (RVM_RGC(bit)) sh_rgc = b;
+    if (RVM_FNC(bit)) sh_fnc = b;
+  }
+}
+
+
+rvm_inst_t isa_encode (InstInfo *in)
+{
+  rvm_inst_t i;
+  int bits;
+  if (sh_opc < 0)
+    probe_fields();
+  i = (rvm_inst_t)in->opc << sh_opc;
+  if (in->ra >= 0)
+    i |= (rvm_inst_t)in->ra << sh_rga;
+  if (in->rb >= 0)
+    i |= (rvm_inst_t)in->rb << sh_rgb;
+  if (in->rc >= 0)
+    i |= (rvm_inst_t)in->rc << sh_rgc;
+  bits = isa_immbits(isa_fmt(in->opc));
+  if (bits)
+    i |= (rvm_inst_t)((unsigned long)in->imms & ((1ul << bits) - 1))
+         << sh_fnc;
+  return i;
+}
+
+
+int isa_index (int op)
+{
+  switch (op) {
+#define DEF(op, idx) case (idx): return ISA_IDX_##op ;
+#include "rvm/opcodes.h"
+#undef DEF
+  default: return ISA_NOPS;
+  }
+}
+
+
+int isa_opcode (int idx)
+{
+  switch (idx) {
+#define DEF(op, idx) case ISA_IDX_##op: return (idx) ;
+#include "rvm/opcodes.h"
+#undef DEF
+  default: return -1;
+  }
+}
+
+
+int isa_isbranch (int op)
+{
+  switch (op) {
+    case RVM_OP_ret:
+    case RVM_OP_jr:
+    case RVM_OP_callr:
+    case RVM_OP_loop:
+      return 1;
+  }
+  return isa_fmt(op) == FMT_PC23;
+}
+
+
+int isa_isterm (int op)
+{
+  return op == RVM_OP_j || op == RVM_OP_jr || op == RVM_OP_ret;
+}
+
+
+long isa_target (unsigned long idx, rvm_inst_t i)
+{
+  /* offsets are relative to the next instruction. */
+  if (isa_fmt(RVM_OPC(i)) == FMT_PC23)
+    return (long)idx + 1 + (long)RVM_SGXTD(RVM_FNC(i) & RVM_F23MASK, 23);
+  return (long)idx + 1 + (long)RVM_SGXTD(RVM_FNC(i) & RVM_F19MASK, 19);
+}
+
+
+unsigned char *isa_leaders (rvm_inst_t *insts, unsigned long n)
+{
+  unsigned long pc;
+  unsigned char *lead = (unsigned char*)calloc(n + 1, 1);
+  if (!lead)
+    return NULL;
+  if (n)
+    lead[0] = 1;
+  for (pc = 0; pc < n; pc++) {
+    int opc = RVM_OPC(insts[pc]);
+    long tgt;
+    if (!isa_isbranch(opc))
+      continue;
+    lead[pc+1] = 1;
+    if (opc == RVM_OP_ret || isa_fmt(opc) == FMT_R)
+      continue;
+    tgt = isa_target(pc, insts[pc]);
+    if (tgt >= 0 && (unsigned long)tgt < n)
+      lead[tgt] = 1;
+  }
+  return lead;
+}
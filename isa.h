@@ -0,0 +1,121 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RVASM_ISA_H_
+#define RVASM_ISA_H_   1
+
+#include "rvm/rvm.h"
+
+/* Operand shapes, one per group of opcodes in rvm/opcodes.h. */
+typedef enum {
+  FMT_NONE,   /* nop                    */
+  FMT_RR,     /* mov  rA, rB            */
+  FMT_TRAP,   /* trap #n                */
+  FMT_RI19,   /* li   rA, #f19          */
+  FMT_RPC19,  /* adr  rA, pc+f19        */
+  FMT_PC23,   /* j    pc+f23            */
+  FMT_R,      /* inc  rA                */
+  FMT_RRR,    /* add  rA, rB, rC        */
+  FMT_RRI15,  /* addi rA, rB, #f15      */
+  FMT_MEM,    /* rd32 rA, [rB + #f15]   */
+  FMT_RAW     /* not a known opcode     */
+} InstFmt;
+
+/* A decoded instruction. Absent registers are -1. */
+typedef struct {
+  int     opc;
+  InstFmt fmt;
+  int     ra, rb, rc;
+  int     immbits;   /* width of the immediate field, 0 if none */
+  long    imms;      /* sign-extended immediate */
+  unsigned long immu; /* zero-extended immediate */
+} InstInfo;
+
+/* Dense opcode indices, in the order of rvm/opcodes.h. */
+enum {
+#define DEF(op, idx) ISA_IDX_##op,
+#include "rvm/opcodes.h"
+#undef DEF
+  ISA_NOPS
+};
+
+/*
+ * Opcode to readable mnemonic.
+ */
+char *to_mnemonic (int op);
+
+/*
+ * Returns the operand shape of an opcode.
+ */
+InstFmt isa_fmt (int op);
+
+/*
+ * Short name of an operand shape, for machine-readable output.
+ */
+char *isa_fmtname (InstFmt fmt);
+
+/*
+ * Splits an instruction into its fields.
+ */
+void isa_decode (rvm_inst_t i, InstInfo *out);
+
+/*
+ * Builds an instruction from `opc`, the registers and `imms`. The
+ * immediate is truncated to the width of the opcode's field.
+ */
+rvm_inst_t isa_encode (InstInfo *in);
+
+/*
+ * Width in bits of the immediate field of an operand shape.
+ */
+int isa_immbits (InstFmt fmt);
+
+/*
+ * Maps an opcode to its dense index (0..ISA_NOPS-1), or ISA_NOPS if
+ * the opcode is unknown.
+ */
+int isa_index (int op);
+
+/*
+ * Maps a dense index back to its opcode.
+ */
+int isa_opcode (int idx);
+
+/*
+ * Returns non-zero if the instruction ends a basic block.
+ */
+int isa_isbranch (int op);
+
+/*
+ * Returns non-zero if control never reaches the next instruction.
+ */
+int isa_isterm (int op);
+
+/*
+ * Returns the word index targeted by a pc-relative instruction at
+ * word index `idx`.
+ */
+long isa_target (unsigned long idx, rvm_inst_t i);
+
+/*
+ * Marks basic block leaders. Returns a malloc'd array of n flags, or
+ * NULL when out of memory.
+ */
+unsigned char *isa_leaders (rvm_inst_t *insts, unsigned long n);
+
+#endif /* RVASM_ISA_H_ */
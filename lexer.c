@@ -17,12 +17,12 @@
  */
 
 #include <ctype.h>
-#include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "perf.h"
 #include "rvasm.h"
 #include "rvm/defs.h"
 #include "utils.h"
@@ -43,6 +43,7 @@ void lex_init (Lexer *l, char *src, char *fname)
   l->tok.tt = TK_NONE;
   l->lkahead.tt = TK_NONE;
   l->end = 0;
+  l->toks = NULL;
 }
 
 
@@ -71,6 +72,32 @@ static char nextc (Lexer *l)
 }
 
 
+/*
+ * The next token of a stored body, with parameters substituted.
+ */
+static Token replay (Lexer *l)
+{
+  Token tok, arg;
+  if (l->ti == l->ntoks) {
+    if (++l->iter >= l->niter) {
+      tok = l->toks[l->ntoks-1];
+      tok.tt = TK_EOF;
+      l->end = 1;
+      return tok;
+    }
+    l->ti = 0;
+  }
+  tok = l->toks[l->ti++];
+  if (tok.tt != TK_PARAM || tok.val < 0 || tok.val >= l->nargs)
+    return tok;
+  arg = l->args[l->iter * (unsigned long)l->nargs + tok.val];
+  /* `\name:` defines the argument as a label */
+  if (tok.text[tok.len] == ':' && arg.tt == TK_IDENT)
+    arg.tt = TK_LABEL;
+  return arg;
+}
+
+
 /*
  * Process the next token.
  */
@@ -80,8 +107,11 @@ static Token tokenize (Lexer *l)
   char c;
   if (l->end)
     return l->tok;
+  if (l->toks)
+    return replay(l);
   tok.tt = TK_UNKNOWN;
   tok.fname = l->fname;
+  tok.val = 0;
 
   for (;;) {
     c = nextc(l);
@@ -127,31 +157,139 @@ static Token tokenize (Lexer *l)
       continue;
     }
 
-    /* op mnemonics and regs */
+    /* numbers: #12, #-0x10, 42 */
+    if (c == '#' || c == '-' || isdigit((unsigned char)c)) {
+      char *end;
+      int neg = 0;
+      if (c == '#') {
+        inc(l);
+        c = nextc(l);
+      }
+      if (c == '-') {
+        neg = 1;
+        inc(l);
+        c = nextc(l);
+      }
+      if (!isdigit((unsigned char)c)) {
+        tok.len = l->pos - tok.pos;
+        break;
+      }
+      tok.val = (long)strtoul(&l->src[l->pos], &end, 0);
+      if (neg)
+        tok.val = -tok.val;
+      while (&l->src[l->pos] < end)
+        inc(l);
+      tok.len = l->pos - tok.pos;
+      tok.tt = TK_NUM;
+      break;
+    }
+
+    /* directives: .include */
+    if (c == '.') {
+      do {
+        inc(l);
+        c = nextc(l);
+        tok.len++;
+      } while (isid(c));
+      tok.tt = tok.len > 1 ? TK_DIRECTIVE : TK_UNKNOWN;
+      break;
+    }
+
+    /* macro parameters, resolved when the body is stored */
+    if (c == '\\' && isid(l->src[l->pos+1])) {
+      do {
+        inc(l);
+        c = nextc(l);
+        tok.len++;
+      } while (isid(c));
+      if (c == ':')
+        inc(l);
+      tok.tt = TK_PARAM;
+      tok.val = -1;
+      break;
+    }
+
+    /* strings, decoded later by lex_str() */
+    if (c == '"') {
+      do {
+        if (c == '\\' && l->src[l->pos+1] != '\0' &&
+            l->src[l->pos+1] != '\n') {
+          inc(l);
+          tok.len++;
+        }
+        inc(l);
+        c = nextc(l);
+        tok.len++;
+      } while (c != '"' && c != '\n' && c != '\0');
+      if (c == '"') {
+        inc(l);
+        tok.len++;
+        tok.tt = TK_STR;
+      }
+      break;
+    }
+
+    /* op mnemonics, regs, labels and symbols */
     if (isid(c)) {
       while (isid(c)) {
         inc(l);
         c = nextc(l);
         tok.len++;
       }
-      if (get_reg_idx(tok.text, tok.len) != -1)
+      if (c == ':') {
+        inc(l);
+        tok.tt = TK_LABEL;
+      }
+      else if (get_reg_idx(tok.text, tok.len) != -1)
         tok.tt = TK_REG;
       else if (get_opcode(tok.text, tok.len) != -1)
         tok.tt = TK_OPNAME;
-      else /* unknown */
-        l->end = 1;
+      else
+        tok.tt = TK_IDENT;
       break;
     }
 
-    /* unknown */
+    /* unknown, the parser skips to the next line */
+    inc(l);
     tok.len++;
-    l->end = 1;
     break;
   }
   return tok;
 }
 
 
+size_t lex_str (Token *tok, char *out)
+{
+  char *s = tok->text + 1, *e = tok->text + tok->len - 1;
+  size_t n = 0;
+  while (s < e) {
+    char c = *s++;
+    if (c == '\\' && s < e) {
+      c = *s++;
+      switch (c) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case '0': c = '\0'; break;
+        case 'x': {
+          int v = 0, k;
+          for (k = 0; k < 2 && s < e && isxdigit((unsigned char)*s); k++) {
+            char h = *s++;
+            v = v * 16 + (isdigit((unsigned char)h) ? h - '0' :
+                          tolower((unsigned char)h) - 'a' + 10);
+          }
+          c = (char)v;
+          break;
+        }
+        default: break;  /* \\ \" and the rest */
+      }
+    }
+    out[n++] = c;
+  }
+  return n;
+}
+
+
 int lex_isact (Lexer *l)
 {
   return !l->end;
@@ -178,59 +316,21 @@ Token *lex_next (Lexer *l)
 
 Token *lex_peek (Lexer *l)
 {
-  if (l->lkahead.tt != TK_NONE)
+  if (l->lkahead.tt == TK_NONE)
     l->lkahead = tokenize(l);
   return &l->lkahead;
 }
 
 
-void print_token (Token *tok, char *fmt, ...)
-{
-  int i, j;
-
-  if (fmt) {
-    va_list ap;
-    printf("%s: ", tok->fname);
-    va_start(ap, fmt);
-    vprintf(fmt, ap);
-    va_end(ap);
-  }
-
-  /* print the token text. */
-  printf("%5lu | ", tok->line);
-  for (i = 0; ; ) {
-    char c = tok->this_ln[i];
-    switch (c) {
-      case '\t':
-        j = TABSTOP - (tok->col % TABSTOP);
-        for (; j > 0; j--)
-          putc(' ', stdout);
-        break;
-      case '\n': case '\r': case '\0':
-        goto stop;
-      default:
-        putc(c, stdout);
-    }
-    i++;
-  }
-
-  stop:
-  /* print a marker indicating where the token is. */
-  putc('\n', stdout);
-  printf("      | ");
-  for (i = 1; i < tok->col; i++)
-    putc(' ', stdout);
-  for (i = 0; i < tok->len; i++)
-    putc('^', stdout);
-  putc('\n', stdout);
-}
+/* whole-token match, `tok` is not NUL-terminated. */
+#define tok_is(t) (strncmp(tok, (t), len) == 0 && (t)[len] == '\0')
 
 
 signed int get_reg_idx (char *tok, int len)
 {
   /* TODO: optimise this */
 #define reg_case(t, v) \
-  if (strncmp(tok, (t), len) == 0) \
+  if (tok_is(t)) \
     return (v);
   reg_case("r0",  RVM_R0);
   reg_case("r1",  RVM_R1);
@@ -257,7 +357,7 @@ signed int get_reg_idx (char *tok, int len)
 signed int get_opcode (char *tok, int len)
 {
 #define DEF(op, idx) \
-  if (strncmp(tok, #op, len) == 0) \
+  if (tok_is(#op)) \
     return (idx);
 #include "rvm/opcodes.h"
 #undef DEF
@@ -267,6 +367,9 @@ signed int get_opcode (char *tok, int len)
 
 static Lexer lst_lex[MAXLSTCKSZ];
 static int lst_top = -1;
+#ifdef RVASM_FUZZING
+static unsigned long fuzz_toks = 0;  /* replayed in this input file */
+#endif
 
 
 void lst_free (void)
@@ -286,10 +389,12 @@ Lexer *lst_curr (void)
 
 static Lexer *lst_push (void)
 {
-  if (lst_top >= MAXLSTCKSZ) {
-    printf("Exceeded max include limit of %d\n", MAXLSTCKSZ);
+  if (lst_top + 1 >= MAXLSTCKSZ) {
+    diag_msg("exceeded max include and expansion depth of %d",
+             MAXLSTCKSZ);
     return NULL;
   }
+  perf_max(C_DEPTH, lst_top + 2);
   return &lst_lex[++lst_top];
 }
 
@@ -298,14 +403,45 @@ static Lexer *lst_pop (void)
 {
   if (lst_top < 0)
     return NULL;
-  return &lst_lex[--lst_top];
+  return &lst_lex[lst_top--];
 }
 
 
+#ifndef RVASM_NOPERF
+/*
+ * Lexing is interleaved with parsing, and a clock read per token would
+ * mostly time the clock. With --stats each file is lexed once more on
+ * its own, with the parse and total timers paused; the parse time is
+ * reported less this.
+ */
+static void time_lex (SrcFile *f)
+{
+  Lexer l;
+  unsigned long n = 0;
+  perf_end(T_TOTAL);
+  perf_end(T_PARSE);
+  perf_begin(T_LEX);
+  lex_init(&l, f->text, f->name);
+  while (tokenize(&l).tt != TK_EOF)
+    n++;
+  perf_end(T_LEX);
+  perf_begin(T_PARSE);
+  perf_begin(T_TOTAL);
+  perf_count(C_TOKENS, n);
+}
+#endif
+
+
 Lexer *lst_newf (char *fname, size_t nlen)
 {
-  char *str, *ncopy;
-  Lexer *l = lst_push();
+  char *ncopy;
+  SrcFile *f;
+  Lexer *l;
+#ifdef RVASM_FUZZING
+  if (lst_top < 0)
+    fuzz_toks = 0;
+#endif
+  l = lst_push();
   if (!l)
     return NULL;
   /* fname is from a source stream. let's get a NUL-terminated copy
@@ -316,21 +452,61 @@ Lexer *lst_newf (char *fname, size_t nlen)
   memcpy(ncopy, fname, nlen);
   ncopy[nlen] = '\0';
   /* read the file */
-  str = read_ascii_file(ncopy, NULL);
-  if (!str)
+  perf_begin(T_LOAD);
+  f = src_open(ncopy);
+  perf_end(T_LOAD);
+  if (!f) {
+    lst_top--;
     return NULL;
-  lex_init(l, str, ncopy);
+  }
+  perf_count(C_FILES, 1);
+  perf_count(C_BYTES, f->size);
+#ifndef RVASM_NOPERF
+  if (perf_on)
+    time_lex(f);
+#endif
+  lex_init(l, f->text, f->name);
   return l;
 }
 
 
-Lexer *lst_popf (void)
+/*
+ * Replays `toks` `niter` times. Iteration i substitutes parameter k
+ * with args[i*nargs + k]. Tokens keep their source locations.
+ */
+Lexer *lst_newt (Token *toks, unsigned long ntoks, Token *args, int nargs,
+                 unsigned long niter)
 {
-  Lexer *curr;
-  if (lst_top < 0)
+  Lexer *l;
+#ifdef RVASM_FUZZING
+  /* nested and recursive expansions multiply, so count them all */
+  if (niter > (FUZZMAXTOKS - fuzz_toks) / ntoks) {
+    diag_tok(&toks[0], "expansion too large for a fuzzing build");
     return NULL;
-  curr = lst_curr();
-  /* tokens might still reference fnames */
-  free(curr->src);
-  return lst_pop();
+  }
+  fuzz_toks += ntoks * niter;
+#endif
+  l = lst_push();
+  if (!l)
+    return NULL;
+  lex_init(l, "", toks[0].fname);
+  l->toks = toks;
+  l->ntoks = ntoks;
+  l->ti = 0;
+  l->iter = 0;
+  l->niter = niter;
+  l->args = args;
+  l->nargs = nargs;
+  return l;
+}
+
+
+Lexer *lst_popf (void)
+{
+  Lexer *l = lst_pop();
+  /* a trailing newline does not start another line */
+  if (l)
+    perf_count(C_LINES, l->line - (*l->curr_ln == '\0'));
+  /* the text stays with its SrcFile for diagnostics */
+  return l;
 }
@@ -0,0 +1,127 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Section garbage collection (--gc-sections).
+ *
+ * Every input file starts a section, and so does each `.section`.
+ * A section is kept if it starts the image or holds the entry symbol,
+ * if a kept section refers to one of its labels (call, j, adr, loop and
+ * the conditional branches), or if a kept section falls through into
+ * it. Everything else is cut from the IR before layout, so offsets are
+ * resolved against the smaller image.
+ *
+ * A numeric pc-relative operand (`j #2`) may land in any section, and
+ * which one is only known after layout, so a kept section with one
+ * keeps them all.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "isa.h"
+#include "rvasm.h"
+
+static IRNode **work;
+static unsigned long nwork;
+static int keep_all;
+
+
+static void mark (IRNode *sect)
+{
+  if (!sect || sect->val.sect.live)
+    return;
+  sect->val.sect.live = 1;
+  work[nwork++] = sect;
+}
+
+
+static void scan (IRNode *sect)
+{
+  IRNode *node, *last = NULL;
+  for (node = sect->next; node && node->type != IR_SECTION;
+       node = node->next) {
+    if (node->type == IR_INSTR && node->val.i.sym)
+      mark(node->val.i.sym->sect);
+    else if (node->type == IR_INSTR && !keep_all) {
+      InstFmt fmt = isa_fmt(node->val.i.opc);
+      keep_all = fmt == FMT_PC23 || fmt == FMT_RPC19;
+    }
+    /* .align only pads, it doesn't stop the fall through */
+    if (node->type != IR_LABEL &&
+        !(node->type == IR_SPACE && node->val.space.align))
+      last = node;
+  }
+  if (node && (!last || (last->type == IR_INSTR &&
+                         !isa_isterm(last->val.i.opc))))
+    mark(node);
+}
+
+
+int rvasm_gc (char *entry, FILE *msg)
+{
+  IRNode *node, *prev, *last;
+  unsigned long n = 0;
+
+  for (node = ir_list(); node; node = node->next)
+    n += node->type == IR_SECTION;
+  if (!n)
+    return 1;
+  work = (IRNode**)malloc(n * sizeof(IRNode*));
+  if (!work)
+    return 0;
+  nwork = 0;
+  keep_all = 0;
+
+  /* the first file's section, where execution starts */
+  mark(ir_list());
+  if (entry) {
+    Symbol *sym = sym_get(entry, strlen(entry));
+    if (!sym || !sym->def) {
+      diag_msg("undefined entry symbol: %s", entry);
+      free(work);
+      return 0;
+    }
+    mark(sym->sect);
+  }
+  while (nwork)
+    scan(work[--nwork]);
+  free(work);
+  if (keep_all)
+    return 1;
+
+  for (prev = NULL, node = ir_list(); node; node = last->next) {
+    int live = node->val.sect.live, empty = 1;
+    for (last = node; last->next && last->next->type != IR_SECTION;
+         last = last->next) {
+      if (!live && last->next->type == IR_LABEL)
+        last->next->val.label->def = NULL;
+      empty = empty && last->next->type == IR_LABEL;
+    }
+    if (live) {
+      prev = last;
+      continue;
+    }
+    if (msg && !empty)
+      fprintf(msg, "rvasm: removing unused section '%s' in file '%s'\n",
+              node->val.sect.name, node->fname);
+    ir_cut(prev, last);
+  }
+  return 1;
+}
@@ -0,0 +1,257 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Macros and repetition: .macro/.endm, .rept/.endr and .irp/.endr.
+ *
+ * A body is read once, as tokens, up to its matching terminator, and
+ * kept in the arena with its `\name` parameters resolved to indices.
+ * Expanding it pushes a replaying Lexer (lst_newt()) that hands the
+ * stored tokens back with arguments substituted, so nothing is lexed
+ * twice and diagnostics point into the body's own source lines.
+ * Expansions nest on the include stack and share its depth limit.
+ *
+ * Arguments are single tokens: registers, numbers, labels or strings.
+ * A label defined inside a body must be a parameter, `\name:`, so that
+ * each expansion defines a different one.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "rvasm.h"
+
+#define iseol(t) ((t)->tt == TK_NEWLN || (t)->tt == TK_EOF)
+#define isdir(t, s) ((t)->tt == TK_DIRECTIVE && \
+  (t)->len == sizeof(s) - 1 && strncmp((t)->text, s, sizeof(s) - 1) == 0)
+
+#define MAXPARAMS  (32)
+
+static ByteBuf scratch;
+
+
+static Token *store (ByteBuf *bb)
+{
+  Token *toks;
+  if (bb->err || !bb->len)
+    return NULL;
+  toks = (Token*)alloc(bb->len);
+  if (toks)
+    memcpy(toks, bb->data, bb->len);
+  return toks;
+}
+
+
+/*
+ * Reads a body up to the matching `.endm` (macro) or `.endr`, and the
+ * rest of that line. `\name` tokens naming one of `params` become its
+ * index; others are left for an inner .irp. A NULL `out` only skips.
+ */
+static int read_body (Lexer *l, Token *dir, int macro, Token *params,
+                      int nparams, Token **out, unsigned long *ntoks)
+{
+  int depth = 0, k;
+  Token *tok;
+
+  scratch.len = 0;
+  scratch.err = 0;
+  for (;;) {
+    Token t;
+    tok = lex_next(l);
+    if (tok->tt == TK_EOF) {
+      diag_tok(dir, macro ? "missing .endm" : "missing .endr");
+      return 0;
+    }
+    if (isdir(tok, ".macro") || isdir(tok, ".rept") || isdir(tok, ".irp"))
+      depth++;
+    else if (isdir(tok, ".endm") || isdir(tok, ".endr")) {
+      if (!depth) {
+        if (isdir(tok, ".endm") != macro) {
+          diag_tok(tok, "unexpected %.*s", (int)tok->len, tok->text);
+          return 0;
+        }
+        break;
+      }
+      depth--;
+    }
+    t = *tok;
+    if (t.tt == TK_PARAM && t.val < 0)
+      for (k = 0; k < nparams; k++)
+        if (params[k].len == t.len - 1 &&
+            strncmp(params[k].text, t.text + 1, t.len - 1) == 0)
+          t.val = k;
+    bb_write(&scratch, &t, sizeof(Token));
+  }
+
+  tok = lex_next(l);
+  if (!iseol(tok)) {
+    diag_tok(tok, "unexpected operand");
+    return 0;
+  }
+  *ntoks = scratch.len / sizeof(Token);
+  if (!out)
+    return 1;
+  *out = store(&scratch);
+  return !*ntoks || *out;
+}
+
+
+/*
+ * After an error in a header, skips the rest of its line and the body,
+ * so that the body isn't read as top-level code. `tok` is the last
+ * token read. Returns 0.
+ */
+static int skip_body (Lexer *l, Token *tok, Token *dir, int macro)
+{
+  unsigned long ntoks;
+  while (!iseol(tok))
+    tok = lex_next(l);
+  if (tok->tt != TK_EOF)
+    read_body(l, dir, macro, NULL, 0, NULL, &ntoks);
+  return 0;
+}
+
+
+/*
+ * .macro name [param, ...]
+ */
+int mac_define (Lexer *l, Token *at)
+{
+  Token params[MAXPARAMS], dir = *at, name, *tok;
+  int nparams = 0;
+  Symbol *sym;
+  Macro *m;
+
+  tok = lex_next(l);
+  if (tok->tt == TK_OPNAME || tok->tt == TK_REG) {
+    diag_tok(tok, "macro name is reserved: %.*s", (int)tok->len,
+             tok->text);
+    return skip_body(l, tok, &dir, 1);
+  }
+  if (tok->tt != TK_IDENT) {
+    diag_tok(tok, "expected a macro name");
+    return skip_body(l, tok, &dir, 1);
+  }
+  name = *tok;
+  for (tok = lex_next(l); !iseol(tok); tok = lex_next(l)) {
+    if (tok->tt != TK_IDENT && tok->tt != TK_REG &&
+        tok->tt != TK_OPNAME) {
+      diag_tok(tok, "expected a parameter name");
+      return skip_body(l, tok, &dir, 1);
+    }
+    if (nparams == MAXPARAMS) {
+      diag_tok(tok, "too many parameters, at most %d", MAXPARAMS);
+      return skip_body(l, tok, &dir, 1);
+    }
+    params[nparams++] = *tok;
+  }
+
+  sym = sym_get(name.text, name.len);
+  m = (Macro*)alloc(sizeof(Macro));
+  if (!sym || !m)
+    return skip_body(l, tok, &dir, 1);
+  if (sym->macro) {
+    diag_tok(&name, "redefinition of macro '%s'", sym->name);
+    return skip_body(l, tok, &dir, 1);
+  }
+  m->nparams = nparams;
+  if (!read_body(l, &dir, 1, params, nparams, &m->body, &m->ntoks))
+    return 0;
+  sym->macro = m;
+  return 1;
+}
+
+
+/*
+ * .rept count, or .irp param, value...
+ */
+int mac_repeat (Lexer *l, Token *at, int irp)
+{
+  Token dir = *at, param, *tok, *body, *args = NULL;
+  unsigned long ntoks, niter = 0;
+
+  tok = lex_next(l);
+  if (irp) {
+    ByteBuf vals;
+    if (tok->tt != TK_IDENT && tok->tt != TK_REG && tok->tt != TK_OPNAME) {
+      diag_tok(tok, "expected a parameter name");
+      return skip_body(l, tok, &dir, 0);
+    }
+    param = *tok;
+    bb_init(&vals);
+    for (tok = lex_next(l); !iseol(tok); tok = lex_next(l)) {
+      bb_write(&vals, tok, sizeof(Token));
+      niter++;
+    }
+    args = niter ? store(&vals) : NULL;
+    bb_free(&vals);
+    if (niter && !args)
+      return skip_body(l, tok, &dir, 0);
+  }
+  else {
+    if (tok->tt != TK_NUM || tok->val < 0) {
+      diag_tok(tok, "expected a repeat count");
+      return skip_body(l, tok, &dir, 0);
+    }
+    niter = (unsigned long)tok->val;
+    tok = lex_next(l);
+    if (!iseol(tok)) {
+      diag_tok(tok, "unexpected operand");
+      return skip_body(l, tok, &dir, 0);
+    }
+  }
+
+  if (!read_body(l, &dir, 0, &param, irp, &body, &ntoks))
+    return 0;
+  if (!ntoks || !niter)
+    return 1;
+  return lst_newt(body, ntoks, args, irp, niter) != NULL;
+}
+
+
+/*
+ * An invocation, `name arg...`. The name has been read.
+ */
+int mac_expand (Lexer *l, Token *at, Macro *m)
+{
+  Token name = *at, *tok, *args = NULL;
+  ByteBuf vals;
+  int nargs = 0;
+
+  bb_init(&vals);
+  for (tok = lex_next(l); !iseol(tok); tok = lex_next(l)) {
+    bb_write(&vals, tok, sizeof(Token));
+    nargs++;
+  }
+  if (nargs != m->nparams) {
+    diag_tok(&name, "macro '%.*s' takes %d argument%s, got %d",
+             (int)name.len, name.text, m->nparams,
+             m->nparams == 1 ? "" : "s", nargs);
+    bb_free(&vals);
+    return 0;
+  }
+  if (nargs) {
+    args = store(&vals);
+    bb_free(&vals);
+    if (!args)
+      return 0;
+  }
+  if (!m->ntoks)
+    return 1;
+  return lst_newt(m->body, m->ntoks, args, nargs, 1) != NULL;
+}
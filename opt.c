@@ -0,0 +1,512 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Register data-flow optimizations (-O2).
+ *
+ * The IR is split into basic blocks at labels, section starts and
+ * after branches; data, .space, .align and .incbin are opaque blocks
+ * that everything is live into. Within each block, copies made by mov
+ * and swp are forwarded to later reads, and a mov that repeats a known
+ * copy is dropped. Then a backward pass computes which registers are
+ * live out of every block, and a side-effect free instruction whose
+ * results are all dead is removed.
+ *
+ * Register sets are bitsets over the register indices, plus a bit for
+ * the condition flags, which cmp and cmpi set and the conditional
+ * branches read. Other ALU instructions are assumed to maybe set them,
+ * so they stay if the flags are live after them. trap, call and callr
+ * read every register and may write any of them; ret, jr, unresolved
+ * targets and the end of the image leave everything live.
+ *
+ * Liveness only grows as blocks are revisited: each change adds at
+ * least one of the 18 bits, so a block is requeued at most 18 times
+ * and the pass is linear in the size of the code.
+ *
+ * A numeric pc-relative operand (`j #3`) may land anywhere, even in
+ * the middle of a block, and removing code would move its target, so
+ * input with one is left alone.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "isa.h"
+#include "perf.h"
+#include "rvasm.h"
+
+typedef unsigned long RegSet;
+
+#define NREGS    (17)                   /* r0-r15, sp */
+#define R_FLAGS  (1ul << NREGS)
+#define R_ALL    ((1ul << (NREGS + 1)) - 1)
+#define R(r)     ((r) >= 0 && (r) < NREGS ? 1ul << (r) : 0)
+#define NOBLK    ((unsigned long)-1)
+
+typedef struct {
+  unsigned long start, end;  /* into `nodes`, [start, end) */
+  unsigned long succ[2];     /* NOBLK if none */
+  int     exits;             /* may leave to unknown code */
+  int     opaque;            /* not code */
+  int     queued;
+  RegSet  in;
+} Block;
+
+typedef struct {
+  RegSet use;
+  RegSet def;    /* may write */
+  RegSet kill;   /* always writes */
+  int    pure;   /* removable when `def` is dead */
+} Effect;
+
+static IRNode **nodes;
+static unsigned char *dead;
+static Block *blk;
+static unsigned long nnodes, nblk;
+
+
+static void effect (IRInst *i, Effect *e)
+{
+  RegSet a = R(i->rgA), b = R(i->rgB), c = R(i->rgC);
+
+  e->use = e->def = e->kill = 0;
+  e->pure = 0;
+  switch (i->opc) {
+    case RVM_OP_nop:
+    case RVM_OP_j:
+    case RVM_OP_ret:
+      return;
+    case RVM_OP_trap:
+    case RVM_OP_call:
+    case RVM_OP_callr:
+      e->use = e->def = R_ALL;
+      return;
+    case RVM_OP_jr:
+      e->use = a;
+      return;
+    case RVM_OP_loop:
+      e->use = e->def = e->kill = a;
+      e->def |= R_FLAGS;
+      return;
+    case RVM_OP_mov:
+      e->use = b;
+      e->def = e->kill = a;
+      e->pure = 1;
+      return;
+    case RVM_OP_swp:
+      e->use = e->def = e->kill = a | b;
+      e->pure = 1;
+      return;
+    case RVM_OP_li:
+    case RVM_OP_adr:
+      e->def = e->kill = a;
+      e->pure = 1;
+      return;
+    case RVM_OP_cmp:
+      e->use = a | b;
+      e->def = e->kill = R_FLAGS;
+      e->pure = 1;
+      return;
+    case RVM_OP_cmpi:
+      e->use = a;
+      e->def = e->kill = R_FLAGS;
+      e->pure = 1;
+      return;
+    case RVM_OP_cpl:
+    case RVM_OP_neg:
+      e->use = b;
+      e->def = e->kill = a;
+      e->def |= R_FLAGS;
+      e->pure = 1;
+      return;
+    case RVM_OP_inc:
+    case RVM_OP_dec:
+      e->use = e->def = e->kill = a;
+      e->def |= R_FLAGS;
+      e->pure = 1;
+      return;
+    /* these may trap on a zero divisor */
+    case RVM_OP_div:
+    case RVM_OP_mod:
+    case RVM_OP_divs:
+    case RVM_OP_divi:
+    case RVM_OP_modi:
+    case RVM_OP_divsi:
+      e->use = b | c;
+      e->def = e->kill = a;
+      e->def |= R_FLAGS;
+      return;
+  }
+
+  switch (isa_fmt(i->opc)) {
+    case FMT_PC23:
+      e->use = R_FLAGS;
+      break;
+    case FMT_RRR:
+    case FMT_RRI15:
+      e->use = b | c;
+      e->def = e->kill = a;
+      e->def |= R_FLAGS;
+      e->pure = 1;
+      break;
+    case FMT_MEM:
+      /* loads may fault, and stay */
+      if (i->opc == RVM_OP_rd8 || i->opc == RVM_OP_rd16 ||
+          i->opc == RVM_OP_rd32 || i->opc == RVM_OP_rd64) {
+        e->use = b;
+        e->def = e->kill = a;
+      }
+      else
+        e->use = a | b;
+      break;
+    default:
+      e->use = e->def = R_ALL;
+      break;
+  }
+}
+
+
+/*
+ * Splits the IR into blocks. Label nodes keep their block in `loc`,
+ * which is free until layout.
+ */
+static int split (void)
+{
+  IRNode *node;
+  unsigned long k, b;
+  int open = 0;
+
+  nnodes = 0;
+  for (node = ir_list(); node; node = node->next)
+    nnodes++;
+  nodes = (IRNode**)malloc((nnodes + 1) * sizeof(IRNode*));
+  dead = (unsigned char*)calloc(nnodes + 1, 1);
+  blk = (Block*)calloc(nnodes + 1, sizeof(Block));
+  if (!nodes || !dead || !blk)
+    return 0;
+
+  nblk = 0;
+  for (k = 0, node = ir_list(); node; node = node->next, k++) {
+    nodes[k] = node;
+    switch (node->type) {
+      case IR_INSTR:
+        if (!open) {
+          blk[nblk++].start = k;
+          open = 1;
+        }
+        if (isa_isbranch(node->val.i.opc))
+          open = 0;
+        break;
+      case IR_LABEL:
+      case IR_SECTION:
+        blk[nblk++].start = k;
+        open = 1;
+        break;
+      default:
+        blk[nblk].start = k;
+        blk[nblk++].opaque = 1;
+        open = 0;
+        break;
+    }
+    if (node->type == IR_LABEL)
+      node->loc = nblk - 1;
+  }
+
+  for (b = 0; b < nblk; b++) {
+    Block *bl = &blk[b];
+    IRInst *i;
+    bl->end = b + 1 < nblk ? blk[b+1].start : nnodes;
+    bl->succ[0] = bl->succ[1] = NOBLK;
+    if (bl->opaque)
+      continue;
+    node = nodes[bl->end - 1];
+    if (node->type != IR_INSTR || !isa_isbranch(node->val.i.opc)) {
+      bl->succ[0] = b + 1 < nblk ? b + 1 : NOBLK;
+      bl->exits = b + 1 == nblk;
+      continue;
+    }
+    i = &node->val.i;
+    if (i->opc == RVM_OP_ret || i->opc == RVM_OP_jr) {
+      bl->exits = 1;
+      continue;
+    }
+    if (!isa_isterm(i->opc))
+      bl->succ[0] = b + 1 < nblk ? b + 1 : NOBLK;
+    bl->exits = b + 1 == nblk && !isa_isterm(i->opc);
+    if (i->opc == RVM_OP_call || i->opc == RVM_OP_callr)
+      continue;
+    if (i->sym && i->sym->def)
+      bl->succ[1] = i->sym->def->loc;
+    else
+      bl->exits = 1;
+  }
+  return 1;
+}
+
+
+static void forget (int *cp, int r)
+{
+  int x;
+  cp[r] = -1;
+  for (x = 0; x < NREGS; x++)
+    if (cp[x] == r)
+      cp[x] = -1;
+}
+
+
+static void subst (int *cp, signed char *r)
+{
+  if (*r >= 0 && *r < NREGS && cp[(int)*r] >= 0) {
+    *r = (signed char)cp[(int)*r];
+    perf_count(C_COPIES, 1);
+  }
+}
+
+
+/*
+ * Forwards copies within a block. cp[r] is a register known to hold
+ * the same value as r, or -1.
+ */
+static void propagate (Block *bl)
+{
+  int cp[NREGS], r, x;
+  unsigned long k;
+
+  for (r = 0; r < NREGS; r++)
+    cp[r] = -1;
+  for (k = bl->start; k < bl->end; k++) {
+    IRInst *i;
+    if (nodes[k]->type != IR_INSTR)
+      continue;
+    i = &nodes[k]->val.i;
+
+    switch (isa_fmt(i->opc)) {
+      case FMT_RR:
+        if (i->opc != RVM_OP_swp)
+          subst(cp, &i->rgB);
+        if (i->opc == RVM_OP_cmp)
+          subst(cp, &i->rgA);
+        break;
+      case FMT_RRR:
+        subst(cp, &i->rgB);
+        subst(cp, &i->rgC);
+        break;
+      case FMT_RRI15:
+        subst(cp, &i->rgB);
+        break;
+      case FMT_MEM:
+        subst(cp, &i->rgB);
+        if (i->opc == RVM_OP_wr8 || i->opc == RVM_OP_wr16 ||
+            i->opc == RVM_OP_wr32 || i->opc == RVM_OP_wr64)
+          subst(cp, &i->rgA);
+        break;
+      default:
+        if (i->opc == RVM_OP_cmpi || i->opc == RVM_OP_jr ||
+            i->opc == RVM_OP_callr)
+          subst(cp, &i->rgA);
+        break;
+    }
+
+    if (i->opc == RVM_OP_mov) {
+      int a = i->rgA, b = i->rgB;
+      if (a < 0 || a >= NREGS || b < 0 || b >= NREGS)
+        continue;
+      /* already holds it */
+      if (a == b || cp[a] == b) {
+        dead[k] = 1;
+        perf_count(C_DEAD, 1);
+        continue;
+      }
+      forget(cp, a);
+      cp[a] = b;
+    }
+    else if (i->opc == RVM_OP_swp) {
+      int a = i->rgA, b = i->rgB, ca, cb;
+      if (a < 0 || a >= NREGS || b < 0 || b >= NREGS)
+        continue;
+      /* the values trade places, and so do the facts about them */
+      ca = cp[a];
+      cb = cp[b];
+      for (x = 0; x < NREGS; x++)
+        cp[x] = cp[x] == a ? b : cp[x] == b ? a : cp[x];
+      cp[a] = cb == a ? -1 : cb;
+      cp[b] = ca == b ? -1 : ca;
+    }
+    else {
+      Effect e;
+      effect(i, &e);
+      if (e.def == R_ALL) {
+        for (r = 0; r < NREGS; r++)
+          cp[r] = -1;
+        continue;
+      }
+      for (r = 0; r < NREGS; r++)
+        if (e.def & R(r))
+          forget(cp, r);
+    }
+  }
+}
+
+
+/*
+ * Live-in of a block given its live-out. Results of removable
+ * instructions that are dead don't make their operands live. With
+ * `sweep`, those instructions are marked for removal.
+ */
+static RegSet transfer (Block *bl, RegSet live, int sweep)
+{
+  unsigned long k;
+  if (bl->opaque)
+    return R_ALL;
+  for (k = bl->end; k-- > bl->start; ) {
+    Effect e;
+    if (nodes[k]->type != IR_INSTR || dead[k])
+      continue;
+    effect(&nodes[k]->val.i, &e);
+    if (e.pure && !(e.def & live)) {
+      if (sweep) {
+        dead[k] = 1;
+        perf_count(C_DEAD, 1);
+      }
+      continue;
+    }
+    live = (live & ~e.kill) | e.use;
+  }
+  return live;
+}
+
+
+static RegSet live_out (Block *bl)
+{
+  RegSet out = bl->exits ? R_ALL : 0;
+  int s;
+  for (s = 0; s < 2; s++)
+    if (bl->succ[s] != NOBLK)
+      out |= blk[bl->succ[s]].in;
+  return out;
+}
+
+
+static int liveness (void)
+{
+  unsigned long *npred, *pred, *work, nwork = 0, b, k;
+  int s;
+
+  /* predecessors, packed per block */
+  npred = (unsigned long*)calloc(nblk + 1, sizeof(unsigned long));
+  pred = (unsigned long*)malloc((2 * nblk + 1) * sizeof(unsigned long));
+  work = (unsigned long*)malloc((nblk + 1) * sizeof(unsigned long));
+  if (!npred || !pred || !work) {
+    free(npred);
+    free(pred);
+    free(work);
+    return 0;
+  }
+  for (b = 0; b < nblk; b++)
+    for (s = 0; s < 2; s++)
+      if (blk[b].succ[s] != NOBLK)
+        npred[blk[b].succ[s] + 1]++;
+  for (b = 0; b < nblk; b++)
+    npred[b+1] += npred[b];
+  for (b = 0; b < nblk; b++)
+    for (s = 0; s < 2; s++)
+      if (blk[b].succ[s] != NOBLK)
+        pred[npred[blk[b].succ[s]]++] = b;
+  /* npred[b] now ends b's run, which starts at npred[b-1] */
+
+  /* the last block comes off the stack first */
+  for (b = 0; b < nblk; b++) {
+    blk[b].in = 0;
+    blk[b].queued = 1;
+    work[nwork++] = b;
+  }
+  while (nwork) {
+    RegSet in;
+    b = work[--nwork];
+    blk[b].queued = 0;
+    in = transfer(&blk[b], live_out(&blk[b]), 0);
+    if (in == blk[b].in)
+      continue;
+    blk[b].in = in;
+    for (k = b ? npred[b-1] : 0; k < npred[b]; k++)
+      if (!blk[pred[k]].queued) {
+        blk[pred[k]].queued = 1;
+        work[nwork++] = pred[k];
+      }
+  }
+
+  for (b = 0; b < nblk; b++)
+    transfer(&blk[b], live_out(&blk[b]), 1);
+  free(npred);
+  free(pred);
+  free(work);
+  return 1;
+}
+
+
+static int has_numeric_target (void)
+{
+  IRNode *node;
+  for (node = ir_list(); node; node = node->next) {
+    InstFmt fmt;
+    if (node->type != IR_INSTR || node->val.i.sym)
+      continue;
+    fmt = isa_fmt(node->val.i.opc);
+    if (fmt == FMT_PC23 || fmt == FMT_RPC19)
+      return 1;
+  }
+  return 0;
+}
+
+
+int rvasm_opt (void)
+{
+  IRNode *node;
+  unsigned long b, k, prev;
+  int ok;
+
+  if (has_numeric_target())
+    return 1;
+
+  nodes = NULL;
+  dead = NULL;
+  blk = NULL;
+  ok = split();
+  if (ok) {
+    for (b = 0; b < nblk; b++)
+      if (!blk[b].opaque)
+        propagate(&blk[b]);
+    ok = liveness();
+  }
+  if (ok) {
+    for (k = prev = 0; k < nnodes; k++) {
+      if (!dead[k])
+        prev = k;
+      else if (k)
+        ir_cut(nodes[prev], nodes[k]);
+    }
+  }
+  for (node = ir_list(); node; node = node->next)
+    node->loc = 0;
+  free(nodes);
+  free(dead);
+  free(blk);
+  if (!ok)
+    diag_msg("out of memory");
+  return ok;
+}
@@ -0,0 +1,108 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Image output. A file is written under a temporary name in the same
+ * directory, with its final size reserved up front, and renamed over
+ * the target only once complete, so readers never see a torn image.
+ * "-" writes to stdout instead.
+ */
+
+#define _XOPEN_SOURCE 700
+#ifdef __linux__
+#define _GNU_SOURCE   /* fallocate */
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rvasm.h"
+
+
+int out_open (OutFile *of, char *path, rsz_t size)
+{
+  mode_t mask;
+  int fd;
+
+  of->path = path;
+  of->tmp = NULL;
+  if (strcmp(path, "-") == 0) {
+    of->fp = stdout;
+    return 1;
+  }
+
+  of->tmp = (char*)malloc(strlen(path) + 8);
+  if (!of->tmp)
+    return 0;
+  sprintf(of->tmp, "%s.XXXXXX", path);
+  fd = mkstemp(of->tmp);
+  if (fd < 0) {
+    free(of->tmp);
+    of->tmp = NULL;
+    return 0;
+  }
+  /* mkstemp() makes it 0600 */
+  mask = umask(0);
+  umask(mask);
+  fchmod(fd, 0666 & ~mask);
+
+  /* not fatal, the writes will fail anyway if the disk is full */
+  if (size) {
+    int rc = -1;
+#ifdef __linux__
+    rc = fallocate(fd, 0, 0, (off_t)size);
+#endif
+    if (rc != 0)
+      rc = ftruncate(fd, (off_t)size);
+    (void)rc;
+  }
+
+  of->fp = fdopen(fd, "wb");
+  if (!of->fp) {
+    close(fd);
+    unlink(of->tmp);
+    free(of->tmp);
+    of->tmp = NULL;
+    return 0;
+  }
+  /* everything is buffered by OutBuf already */
+  setvbuf(of->fp, NULL, _IONBF, 0);
+  return 1;
+}
+
+
+int out_commit (OutFile *of, int ok)
+{
+  if (!of->tmp) {
+    ok = (fflush(of->fp) == 0) && ok;
+    return ok;
+  }
+  ok = (fclose(of->fp) == 0) && ok;
+  if (ok && rename(of->tmp, of->path) != 0)
+    ok = 0;
+  if (!ok)
+    unlink(of->tmp);
+  free(of->tmp);
+  of->tmp = NULL;
+  of->fp = NULL;
+  return ok;
+}
@@ -18,16 +18,52 @@
 
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "isa.h"
+#include "perf.h"
 #include "rvasm.h"
 
+#define iseol(t) ((t)->tt == TK_NEWLN || (t)->tt == TK_EOF)
+
+static IRNode *ir_head = NULL, *ir_tail = NULL;
+static IRNode *ir_bin = NULL;
+static IRNode *ir_sect = NULL;  /* the current section */
+static ByteBuf scratch;
+
+
+void ir_init (void)
+{
+  ir_head = ir_tail = NULL;
+  ir_bin = NULL;
+  ir_sect = NULL;
+}
+
+
+/*
+ * Closes .incbin files. The nodes themselves live in the arena.
+ */
+void ir_free (void)
+{
+  IRNode *node;
+  for (node = ir_bin; node; node = node->val.bin.link)
+    if (node->val.bin.own)
+      close_file(node->val.bin.fd);
+  ir_bin = NULL;
+  bb_free(&scratch);
+}
+
 
 IRNode *ir_push (void)
 {
   IRNode *node = (IRNode*)alloc(sizeof(IRNode));
-  static IRNode *ir_head = NULL, *ir_tail = NULL;
+  if (!node)
+    return NULL;
+  perf_count(C_IRNODES, 1);
   node->next = NULL;
+  node->loc = 0;
+  node->size = 0;
   if (!ir_head)
     ir_head = node;
   if (ir_tail)
@@ -37,20 +73,580 @@ IRNode *ir_push (void)
 }
 
 
+IRNode *ir_list (void)
+{
+  return ir_head;
+}
+
+
+/*
+ * Removes the nodes after `prev`, up to and including `last`.
+ */
+void ir_cut (IRNode *prev, IRNode *last)
+{
+  prev->next = last->next;
+  if (ir_tail == last)
+    ir_tail = prev;
+}
+
+
+static IRNode *new_node (IRType type, Token *tok)
+{
+  IRNode *node = ir_push();
+  if (!node)
+    return NULL;
+  node->type = type;
+  node->fname = tok->fname;
+  node->line = tok->line;
+  node->col = tok->col;
+  return node;
+}
+
+
+static int expect_reg (Lexer *l, signed char *out)
+{
+  Token *tok = lex_next(l);
+  if (tok->tt != TK_REG) {
+    diag_tok(tok, "expected a register");
+    return 0;
+  }
+  *out = (signed char)get_reg_idx(tok->text, tok->len);
+  return 1;
+}
+
+
+static int expect_num (Lexer *l, long *out)
+{
+  Token *tok = lex_next(l);
+  if (tok->tt != TK_NUM) {
+    diag_tok(tok, "expected a number");
+    return 0;
+  }
+  *out = tok->val;
+  return 1;
+}
+
+
+/* a label, or a raw word offset. */
+static int expect_target (Lexer *l, IRInst *i)
+{
+  Token *tok = lex_next(l);
+  if (tok->tt == TK_NUM) {
+    i->imm = tok->val;
+    return 1;
+  }
+  /* labels may share names with mnemonics. */
+  if (tok->tt != TK_IDENT && tok->tt != TK_OPNAME) {
+    diag_tok(tok, "expected a label");
+    return 0;
+  }
+  i->sym = sym_get(tok->text, tok->len);
+  return i->sym != NULL;
+}
+
+
+static int parse_inst (Lexer *l, Token *op)
+{
+  IRNode *node;
+  IRInst *i;
+  Token *tok;
+  int ok = 1;
+
+  node = new_node(IR_INSTR, op);
+  if (!node)
+    return 0;
+  node->size = sizeof(rvm_inst_t);
+  i = &node->val.i;
+  i->opc = get_opcode(op->text, op->len);
+  i->rgA = i->rgB = i->rgC = -1;
+  i->imm = 0;
+  i->sym = NULL;
+
+  switch (isa_fmt(i->opc)) {
+    case FMT_NONE:
+    case FMT_RAW:
+      break;
+    case FMT_RR:
+      ok = expect_reg(l, &i->rgA) && expect_reg(l, &i->rgB);
+      break;
+    case FMT_TRAP:
+      ok = expect_num(l, &i->imm);
+      break;
+    case FMT_RI19:
+      ok = expect_reg(l, &i->rgA) && expect_num(l, &i->imm);
+      break;
+    case FMT_RPC19:
+      ok = expect_reg(l, &i->rgA) && expect_target(l, i);
+      break;
+    case FMT_PC23:
+      ok = expect_target(l, i);
+      break;
+    case FMT_R:
+      ok = expect_reg(l, &i->rgA);
+      break;
+    case FMT_RRR:
+      ok = expect_reg(l, &i->rgA) && expect_reg(l, &i->rgB) &&
+           expect_reg(l, &i->rgC);
+      break;
+    case FMT_RRI15:
+      ok = expect_reg(l, &i->rgA) && expect_reg(l, &i->rgB) &&
+           expect_num(l, &i->imm);
+      break;
+    case FMT_MEM:
+      /* rA, [rB] or rA, [rB + #off] */
+      ok = expect_reg(l, &i->rgA) && expect_reg(l, &i->rgB);
+      if (!ok)
+        break;
+      tok = lex_next(l);
+      if (tok->tt == TK_NUM)
+        i->imm = tok->val;
+      else if (iseol(tok))
+        return 1;
+      else {
+        diag_tok(tok, "expected an offset");
+        return 0;
+      }
+      break;
+  }
+  if (!ok)
+    return 0;
+
+  tok = lex_next(l);
+  if (!iseol(tok)) {
+    diag_tok(tok, "unexpected operand");
+    return 0;
+  }
+  return 1;
+}
+
+
+/*
+ * Resolves `name` against the directory of the including file.
+ */
+static char *include_path (char *from, char *name, size_t len, size_t *olen)
+{
+  char *slash = strrchr(from, '/'), *path;
+  size_t dlen = (name[0] == '/' || !slash) ? 0 : (size_t)(slash - from) + 1;
+#ifdef RVASM_FUZZING
+  /* only files next to the input */
+  if (name[0] == '/')
+    return NULL;
+#endif
+  path = (char*)alloc(dlen + len + 1);
+  if (!path)
+    return NULL;
+  memcpy(path, from, dlen);
+  memcpy(path + dlen, name, len);
+  path[dlen + len] = '\0';
+  *olen = dlen + len;
+  return path;
+}
+
+
+static int dir_include (Lexer *l)
+{
+  Token *tok = lex_next(l), ftok;
+  char *name, *path;
+  size_t len, plen;
+
+  if (tok->tt != TK_STR) {
+    diag_tok(tok, "expected a file name");
+    return 0;
+  }
+  ftok = *tok;
+  name = (char*)alloc(ftok.len);
+  if (!name)
+    return 0;
+  len = lex_str(&ftok, name);
+
+  tok = lex_next(l);
+  if (!iseol(tok)) {
+    diag_tok(tok, "unexpected operand");
+    return 0;
+  }
+  /* the rest of this file resumes after the included one */
+  path = include_path(ftok.fname, name, len, &plen);
+  if (!path || !lst_newf(path, plen)) {
+    diag_tok(&ftok, "could not include file");
+    return 0;
+  }
+  return 1;
+}
+
+
+/*
+ * .byte/.half/.word/.dword n, ... (width in bytes), and
+ * .ascii/.asciz "s", ... (width 0).
+ */
+static int dir_data (Lexer *l, Token *dir, int width, int zterm)
+{
+  IRNode *node;
+  Token *tok;
+
+  scratch.len = 0;
+  scratch.err = 0;
+  for (tok = lex_next(l); !iseol(tok); tok = lex_next(l)) {
+    unsigned char tmp[8];
+    unsigned long v;
+    int i;
+
+    if (!width) {
+      char *s;
+      if (tok->tt != TK_STR) {
+        diag_tok(tok, "expected a string");
+        return 0;
+      }
+      s = (char*)malloc(tok->len);
+      if (!s)
+        return 0;
+      bb_write(&scratch, s, lex_str(tok, s));
+      if (zterm)
+        bb_write(&scratch, "", 1);
+      free(s);
+      continue;
+    }
+    if (tok->tt != TK_NUM) {
+      diag_tok(tok, "expected a number");
+      return 0;
+    }
+    /* either signed or unsigned, like immediates */
+    if (width < (int)sizeof(long) &&
+        (tok->val < -(1l << (width*8 - 1)) ||
+         tok->val > (1l << (width*8)) - 1)) {
+      diag_tok(tok, "value out of range: %ld", tok->val);
+      return 0;
+    }
+    for (i = 0, v = (unsigned long)tok->val; i < width; i++, v >>= 8)
+      tmp[i] = (unsigned char)(v & 0xff);
+    bb_write(&scratch, tmp, (size_t)width);
+  }
+  if (scratch.err)
+    return 0;
+  if (!scratch.len)
+    return 1;
+
+  node = new_node(IR_DATA, dir);
+  if (!node)
+    return 0;
+  node->size = scratch.len;
+  node->val.data = (unsigned char*)alloc(scratch.len);
+  if (!node->val.data)
+    return 0;
+  memcpy(node->val.data, scratch.data, scratch.len);
+  return 1;
+}
+
+
+/*
+ * .space n[, fill] and .align n[, fill], n in bytes.
+ */
+static int dir_space (Lexer *l, Token *dir, int align)
+{
+  IRNode *node;
+  Token *tok;
+  long n, fill = 0;
+
+  if (!expect_num(l, &n))
+    return 0;
+  if (n < 0 || (align && (n == 0 || (n & (n - 1))))) {
+    diag_tok(lex_curr(l), align ? "alignment must be a power of two"
+                                : "size must not be negative");
+    return 0;
+  }
+#ifdef RVASM_FUZZING
+  if (n > (long)FUZZMAXSPACE)
+    n = (long)FUZZMAXSPACE;
+#endif
+  tok = lex_next(l);
+  if (tok->tt == TK_NUM) {
+    fill = tok->val;
+    if (fill < -128 || fill > 255) {
+      diag_tok(tok, "value out of range: %ld", fill);
+      return 0;
+    }
+    tok = lex_next(l);
+  }
+  if (!iseol(tok)) {
+    diag_tok(tok, "unexpected operand");
+    return 0;
+  }
+
+  node = new_node(IR_SPACE, dir);
+  if (!node)
+    return 0;
+  node->size = align ? 0 : (rsz_t)n;
+  node->val.space.align = align ? (rsz_t)n : 0;
+  node->val.space.fill = (unsigned char)fill;
+  return 1;
+}
+
+
+/*
+ * .incbin "file"[, skip[, count]]. The file stays open until ir_free(),
+ * and the image is written from that descriptor, so what is copied is
+ * the file that was checked here even if it is replaced meanwhile.
+ */
+static int dir_incbin (Lexer *l, Token *dir)
+{
+  Token *tok = lex_next(l), ftok;
+  IRNode *node, *prev;
+  SrcFile *src;
+  char *name, *path;
+  size_t len, plen, sz = 0;
+  long skip = 0, count = -1;
+  int fd = -1;
+
+  if (tok->tt != TK_STR) {
+    diag_tok(tok, "expected a file name");
+    return 0;
+  }
+  ftok = *tok;
+  name = (char*)alloc(ftok.len);
+  if (!name)
+    return 0;
+  len = lex_str(&ftok, name);
+
+  tok = lex_next(l);
+  if (tok->tt == TK_NUM) {
+    skip = tok->val;
+    tok = lex_next(l);
+    if (tok->tt == TK_NUM) {
+      count = tok->val;
+      tok = lex_next(l);
+    }
+  }
+  if (!iseol(tok)) {
+    diag_tok(tok, "unexpected operand");
+    return 0;
+  }
+
+  path = include_path(ftok.fname, name, len, &plen);
+  /* an input for -MD and the server, but never loaded as text */
+  src = path ? src_note(path) : NULL;
+  for (prev = ir_bin; src && prev; prev = prev->val.bin.link)
+    if (prev->val.bin.src == src) {
+      fd = prev->val.bin.fd;
+      sz = prev->val.bin.size;
+      break;
+    }
+  if (src && !prev)
+    fd = open_file(path, &sz);
+  if (fd < 0) {
+    diag_tok(&ftok, "could not read file");
+    return 0;
+  }
+  if (skip < 0 || (size_t)skip > sz || count < -1 ||
+      (count >= 0 && (size_t)count > sz - (size_t)skip)) {
+    diag_tok(&ftok, "range is outside the file");
+    if (!prev)
+      close_file(fd);
+    return 0;
+  }
+
+  node = new_node(IR_INCBIN, dir);
+  if (!node) {
+    if (!prev)
+      close_file(fd);
+    return 0;
+  }
+  node->size = count >= 0 ? (rsz_t)count : (rsz_t)(sz - (size_t)skip);
+  node->val.bin.src = src;
+  node->val.bin.fd = fd;
+  node->val.bin.own = !prev;
+  node->val.bin.size = sz;
+  node->val.bin.off = (size_t)skip;
+  node->val.bin.link = ir_bin;
+  ir_bin = node;
+  return 1;
+}
+
+
+static IRNode *new_sect (Token *tok, char *name)
+{
+  IRNode *node = new_node(IR_SECTION, tok);
+  if (!node)
+    return NULL;
+  node->val.sect.name = name;
+  node->val.sect.live = 0;
+  return ir_sect = node;
+}
+
+
+/*
+ * .section name. The name is only shown by --print-gc-sections.
+ */
+static int dir_section (Lexer *l, Token *dir)
+{
+  Token *tok = lex_next(l);
+  char *name, *start, *end;
+
+  if (tok->tt == TK_STR) {
+    name = (char*)alloc(tok->len + 1);
+    if (!name)
+      return 0;
+    name[lex_str(tok, name)] = '\0';
+    tok = lex_next(l);
+  }
+  else if (tok->tt == TK_IDENT || tok->tt == TK_DIRECTIVE ||
+           tok->tt == TK_OPNAME) {
+    /* `.text.foo` lexes as two directives, glue them back */
+    start = tok->text;
+    end = tok->text + tok->len;
+    for (tok = lex_next(l); !iseol(tok) && tok->text == end;
+         tok = lex_next(l))
+      end += tok->len;
+    name = (char*)alloc((size_t)(end - start) + 1);
+    if (!name)
+      return 0;
+    memcpy(name, start, (size_t)(end - start));
+    name[end - start] = '\0';
+  }
+  else {
+    diag_tok(tok, "expected a section name");
+    return 0;
+  }
+  if (!iseol(tok)) {
+    diag_tok(tok, "unexpected operand");
+    return 0;
+  }
+  return new_sect(dir, name) != NULL;
+}
+
+
+#define isdir(t, s) \
+  ((t)->len == sizeof(s) - 1 && strncmp((t)->text, s, sizeof(s) - 1) == 0)
+
+static int parse_directive (Lexer *l, Token *tok)
+{
+  if (isdir(tok, ".include"))
+    return dir_include(l);
+  if (isdir(tok, ".byte"))
+    return dir_data(l, tok, 1, 0);
+  if (isdir(tok, ".half"))
+    return dir_data(l, tok, 2, 0);
+  if (isdir(tok, ".word"))
+    return dir_data(l, tok, 4, 0);
+  if (isdir(tok, ".dword"))
+    return dir_data(l, tok, 8, 0);
+  if (isdir(tok, ".ascii"))
+    return dir_data(l, tok, 0, 0);
+  if (isdir(tok, ".asciz"))
+    return dir_data(l, tok, 0, 1);
+  if (isdir(tok, ".space"))
+    return dir_space(l, tok, 0);
+  if (isdir(tok, ".align"))
+    return dir_space(l, tok, 1);
+  if (isdir(tok, ".incbin"))
+    return dir_incbin(l, tok);
+  if (isdir(tok, ".section"))
+    return dir_section(l, tok);
+  if (isdir(tok, ".macro"))
+    return mac_define(l, tok);
+  if (isdir(tok, ".rept"))
+    return mac_repeat(l, tok, 0);
+  if (isdir(tok, ".irp"))
+    return mac_repeat(l, tok, 1);
+  if (isdir(tok, ".endm") || isdir(tok, ".endr")) {
+    diag_tok(tok, "unexpected %.*s", (int)tok->len, tok->text);
+    return 0;
+  }
+  diag_tok(tok, "unknown directive");
+  return 0;
+}
+
+
+static int parse_line (Lexer *l)
+{
+  Token *tok = lex_next(l);
+
+  if (tok->tt == TK_LABEL) {
+    Symbol *sym = sym_get(tok->text, tok->len);
+    IRNode *node;
+    if (!sym)
+      return 0;
+    if (sym->def) {
+      diag_tok(tok, "redefinition of '%s'", sym->name);
+      return 0;
+    }
+    node = new_node(IR_LABEL, tok);
+    if (!node)
+      return 0;
+    node->val.label = sym;
+    sym->def = node;
+    sym->sect = ir_sect;
+    tok = lex_next(l);
+  }
+
+  if (iseol(tok))
+    return 1;
+  if (tok->tt == TK_UNKNOWN) {
+    diag_tok(tok, tok->text[0] == '"' ? "unterminated string" :
+                  "unknown character");
+    return 0;
+  }
+  if (tok->tt == TK_DIRECTIVE)
+    return parse_directive(l, tok);
+  if (tok->tt == TK_IDENT) {
+    Symbol *sym = sym_get(tok->text, tok->len);
+    if (sym && sym->macro)
+      return mac_expand(l, tok, sym->macro);
+  }
+  if (tok->tt != TK_OPNAME) {
+    diag_tok(tok, "expected an instruction");
+    return 0;
+  }
+  return parse_inst(l, tok);
+}
+
+
 int rvasm_parse (char *path)
 {
   Lexer *l = NULL;
+  Token start;
+  int ok = 1;
+  if (!lst_newf(path, strlen(path))) {
+    diag_msg("could not load file: %s", path);
+    return 0;
+  }
+  /* each file starts in a section of its own */
+  start.fname = lst_curr()->fname;
+  start.line = start.col = 1;
+  if (!new_sect(&start, ".text"))
+    return 0;
+  while ((l = lst_curr()) && !diag_full()) {
+    /* end of an included file, back to the includer */
+    if (!lex_isact(l)) {
+      lst_popf();
+      continue;
+    }
+    if (parse_line(l))
+      continue;
+    /* resync at the next line */
+    ok = 0;
+    while (!iseol(lex_curr(l)))
+      lex_next(l);
+  }
+  lst_free();
+  return ok;
+}
+
+
+int rvasm_lex (char *path)
+{
+  Lexer *l = NULL;
+  int ok = 1;
   l = lst_newf(path, strlen(path));
   if (!l) {
-    printf("Could not load file: %s\n", path);
+    diag_msg("could not load file: %s", path);
     return 0;
   }
-  /* print all tokens. */
   while (lex_isact(l)) {
-    Token *tok;
-    tok = lex_next(l);
-    print_token(tok, "tok: %d\n", tok->tt);
+    Token *tok = lex_next(l);
+    if (tok->tt == TK_UNKNOWN) {
+      diag_tok(tok, "unknown character");
+      ok = 0;
+    }
   }
   lst_free();
-  return 1;
+  return ok;
 }
@@ -0,0 +1,157 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rvm/rvm.h"
+#include "isa.h"
+#include "rvasm.h"
+
+static OutBuf out;
+
+
+/*
+ * Assigns addresses. Returns the size of the image.
+ */
+rsz_t rvasm_layout (void)
+{
+  IRNode *node;
+  rpos_t loc = 0;
+  for (node = ir_list(); node; node = node->next) {
+    node->loc = loc;
+    if (node->type == IR_SPACE && node->val.space.align)
+      node->size = (node->val.space.align - loc % node->val.space.align) %
+                   node->val.space.align;
+    loc += node->size;
+  }
+  return loc;
+}
+
+
+static int encode_inst (IRNode *node, rvm_inst_t *out_inst)
+{
+  IRInst *i = &node->val.i;
+  InstInfo in;
+  long imm = i->imm, lo, hi;
+  int bits, pcrel = 0;
+
+  in.opc = i->opc;
+  in.fmt = isa_fmt(i->opc);
+  in.ra = i->rgA;
+  in.rb = i->rgB;
+  in.rc = i->rgC;
+
+  if (i->sym) {
+    if (!i->sym->def) {
+      diag_at(node->fname, node->line, node->col, 0,
+              "undefined symbol: %s", i->sym->name);
+      return 0;
+    }
+    if (i->sym->def->loc & 3) {
+      diag_at(node->fname, node->line, node->col, 0,
+              "target is not word aligned: %s", i->sym->name);
+      return 0;
+    }
+    /* offsets are in words, relative to the next instruction. */
+    imm = (long)(i->sym->def->loc >> 2) - (long)(node->loc >> 2) - 1;
+    pcrel = 1;
+  }
+  else if (in.fmt == FMT_PC23 || in.fmt == FMT_RPC19)
+    pcrel = 1;
+
+  /* signed fields also take their unsigned range, except offsets. */
+  bits = isa_immbits(in.fmt);
+  if (bits && in.fmt != FMT_RRR) {
+    lo = -(1l << (bits-1));
+    hi = pcrel ? (1l << (bits-1)) - 1 : (1l << bits) - 1;
+    if (imm < lo || imm > hi) {
+      diag_at(node->fname, node->line, node->col, 0,
+              "immediate out of range: %ld", imm);
+      return 0;
+    }
+  }
+  in.imms = imm;
+  *out_inst = isa_encode(&in);
+  return 1;
+}
+
+
+static void put_fill (unsigned char fill, rsz_t n)
+{
+  unsigned char tmp[256];
+  /* only checking for errors, don't spin on a huge .space */
+  if (!out.fp)
+    return;
+  memset(tmp, fill, sizeof(tmp));
+  for (; n > sizeof(tmp); n -= sizeof(tmp))
+    ob_write(&out, tmp, sizeof(tmp));
+  ob_write(&out, tmp, n);
+}
+
+
+int rvasm_encode (FILE *fp)
+{
+  IRNode *node;
+  int ok = 1;
+  ob_init(&out, fp);
+  for (node = ir_list(); node; node = node->next) {
+    rvm_inst_t inst;
+    switch (node->type) {
+      case IR_INSTR:
+        break;
+      case IR_DATA:
+        ob_write(&out, node->val.data, node->size);
+        continue;
+      case IR_SPACE:
+        put_fill(node->val.space.fill, node->size);
+        continue;
+      case IR_INCBIN:
+        if (!ob_copy(&out, node->val.bin.fd, node->val.bin.off,
+                     node->size)) {
+          diag_at(node->fname, node->line, node->col, 0,
+                  "file was cut short while assembling");
+          ok = 0;
+        }
+        continue;
+      default:
+        continue;
+    }
+    if (node->loc & 3) {
+      diag_at(node->fname, node->line, node->col, 0,
+              "instruction is not word aligned, use .align 4");
+      ok = 0;
+      if (diag_full())
+        break;
+      continue;
+    }
+    if (!encode_inst(node, &inst)) {
+      ok = 0;
+      if (diag_full())
+        break;
+      continue;
+    }
+    dbg_line(node->loc, node->fname, node->line);
+    ob_putle(&out, (unsigned long)inst, sizeof(rvm_inst_t));
+  }
+  if (ob_flush(&out)) {
+    diag_msg("could not write output");
+    return 0;
+  }
+  return ok;
+}
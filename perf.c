@@ -0,0 +1,162 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "perf.h"
+#include "rvasm.h"
+
+static char *timer_names[NTIMERS] = {
+  "load", "lex", "parse", "link", "opt", "layout", "encode", "output",
+  "total"
+};
+
+static char *counter_names[NCOUNTERS] = {
+  "files", "bytes", "lines", "tokens", "ir_nodes", "include_depth",
+  "dead_insts", "copies"
+};
+
+#ifndef RVASM_NOPERF
+
+int perf_on = 0;
+unsigned long perf_cnt[NCOUNTERS];
+
+static double t_acc[NTIMERS];
+static double t_start[NTIMERS];
+
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+void perf_start (PerfTimer t)
+{
+  t_start[t] = now();
+}
+
+
+void perf_stop (PerfTimer t)
+{
+  t_acc[t] += now() - t_start[t];
+}
+
+
+void perf_enable (void)
+{
+  perf_on = 1;
+}
+
+
+void perf_reset (void)
+{
+  perf_on = 0;
+  memset(perf_cnt, 0, sizeof(perf_cnt));
+  memset(t_acc, 0, sizeof(t_acc));
+}
+
+
+/* parse time is reported without the loading and lexing inside it. */
+static double timer_excl (int t)
+{
+  double d;
+  if (t != T_PARSE)
+    return t_acc[t];
+  /* lexing was timed apart, so this can dip below zero */
+  d = t_acc[T_PARSE] - t_acc[T_LEX] - t_acc[T_LOAD];
+  return d > 0 ? d : 0;
+}
+
+
+void perf_report (FILE *fp, int json, int timers_only)
+{
+  size_t used = 0, cap = 0, waste = 0, blocks = 0;
+  Arena *ar;
+  int i;
+
+  for (ar = glob_mem; ar; ar = ar->next) {
+    used += ar->pos;
+    cap += ar->size;
+    blocks++;
+    /* space left behind when allocation moved to the next block */
+    if (ar->next)
+      waste += ar->size - ar->pos;
+  }
+
+  if (json) {
+    fprintf(fp, "{\"timers_ms\": {");
+    for (i = 0; i < NTIMERS; i++)
+      fprintf(fp, "%s\"%s\": %.3f", i ? ", " : "", timer_names[i],
+              timer_excl(i) * 1e3);
+    fprintf(fp, "}");
+    if (!timers_only) {
+      fprintf(fp, ", \"counters\": {");
+      for (i = 0; i < NCOUNTERS; i++)
+        fprintf(fp, "%s\"%s\": %lu", i ? ", " : "", counter_names[i],
+                perf_cnt[i]);
+      fprintf(fp, "}, \"arena\": {\"used\": %lu, \"capacity\": %lu, "
+              "\"blocks\": %lu, \"waste\": %lu}",
+              (unsigned long)used, (unsigned long)cap,
+              (unsigned long)blocks, (unsigned long)waste);
+    }
+    fprintf(fp, "}\n");
+    return;
+  }
+
+  fprintf(fp, "%-16s %12s\n", "pass", "time (ms)");
+  for (i = 0; i < NTIMERS; i++)
+    fprintf(fp, "%-16s %12.3f\n", timer_names[i], timer_excl(i) * 1e3);
+  if (timers_only)
+    return;
+  fprintf(fp, "\n%-16s %12s\n", "counter", "value");
+  for (i = 0; i < NCOUNTERS; i++)
+    fprintf(fp, "%-16s %12lu\n", counter_names[i], perf_cnt[i]);
+  fprintf(fp, "%-16s %12lu\n", "arena_used", (unsigned long)used);
+  fprintf(fp, "%-16s %12lu\n", "arena_capacity", (unsigned long)cap);
+  fprintf(fp, "%-16s %12lu\n", "arena_blocks", (unsigned long)blocks);
+  fprintf(fp, "%-16s %12lu\n", "arena_waste", (unsigned long)waste);
+}
+
+#else
+
+void perf_enable (void)
+{
+}
+
+
+void perf_reset (void)
+{
+}
+
+
+void perf_report (FILE *fp, int json, int timers_only)
+{
+  (void)timer_names;
+  (void)counter_names;
+  (void)timers_only;
+  fprintf(fp, json ? "{}\n" : "rvasm: built without instrumentation\n");
+}
+
+#endif
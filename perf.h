@@ -0,0 +1,93 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RVASM_PERF_H_
+#define RVASM_PERF_H_   1
+
+#include <stdio.h>
+
+/*
+ * Assembler instrumentation. Counters and timers only run after
+ * perf_enable(); build with -DRVASM_NOPERF to compile every hook out.
+ */
+
+typedef enum {
+  T_LOAD,     /* read_ascii_file() */
+  T_LEX,      /* tokenize(), once per file */
+  T_PARSE,    /* pass1, including the above */
+  T_LINK,     /* --gc-sections */
+  T_OPT,      /* -O2 */
+  T_LAYOUT,
+  T_ENCODE,
+  T_OUTPUT,   /* closing the image, writing debug info */
+  T_TOTAL,
+  NTIMERS
+} PerfTimer;
+
+typedef enum {
+  C_FILES,
+  C_BYTES,
+  C_LINES,
+  C_TOKENS,   /* in source files, not macro expansions */
+  C_IRNODES,
+  C_DEPTH,    /* deepest include level reached */
+  C_DEAD,     /* instructions removed by -O2 */
+  C_COPIES,   /* register reads forwarded by -O2 */
+  NCOUNTERS
+} PerfCounter;
+
+#ifdef RVASM_NOPERF
+
+#define perf_count(c, n)  ((void)0)
+#define perf_max(c, v)    ((void)0)
+#define perf_begin(t)     ((void)0)
+#define perf_end(t)       ((void)0)
+
+#else
+
+extern int perf_on;
+extern unsigned long perf_cnt[NCOUNTERS];
+
+void perf_start (PerfTimer t);
+void perf_stop (PerfTimer t);
+
+#define perf_count(c, n)  ((void)(perf_on ? (perf_cnt[(c)] += (n)) : 0))
+#define perf_max(c, v)    ((void)(perf_on && \
+                           perf_cnt[(c)] < (unsigned long)(v) ? \
+                           (perf_cnt[(c)] = (v)) : 0))
+#define perf_begin(t)     (perf_on ? perf_start(t) : (void)0)
+#define perf_end(t)       (perf_on ? perf_stop(t) : (void)0)
+
+#endif
+
+/*
+ * Turns on the timers.
+ */
+void perf_enable (void);
+
+/*
+ * Clears all timers and counters, and turns the timers off.
+ */
+void perf_reset (void);
+
+/*
+ * Prints the report, as a table or as JSON.
+ */
+void perf_report (FILE *fp, int json, int timers_only);
+
+#endif /* RVASM_PERF_H_ */
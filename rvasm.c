@@ -17,34 +17,291 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "rvm/rvm.h"
+#include "perf.h"
 #include "rvasm.h"
 
 Arena *glob_mem = NULL;
 
 
+static void usage (FILE *fp, char *prog)
+{
+  fprintf(fp, ""
+    "usage: %s [-g] [-o OUT] FILE...\n"
+    RVM_LABEL " Bytecode Assembler\n"
+    "Copyright (C) 2025  Vincent Yanzee J. Tan\n"
+    "This program is licensed under the GNU General Public\n"
+    "License v3 or later. See <https://www.gnu.org/licenses/>\n"
+    "for details.\n"
+    "\n"
+    "  -o OUT     write the image to OUT, - for stdout (default: a.out)\n"
+    "  -g         also write a pc-to-source table to OUT.dbg\n"
+    "  -MD        write a make dependency file (default: OUT.d)\n"
+    "  -MF FILE   name of the dependency file\n"
+    "  -MP        add a phony target for each include\n"
+    , prog);
+  fprintf(fp, ""
+    "  -O2        drop register writes that are never read, and forward\n"
+    "             copies made by mov and swp (default: -O0)\n"
+    "  --gc-sections\n"
+    "             drop sections not reachable from the image start\n"
+    "  --entry SYM\n"
+    "             also keep the section defining SYM\n"
+    "  --print-gc-sections\n"
+    "             list the sections dropped\n");
+  fprintf(fp, ""
+    "  --stats    print pass times and counters after the diagnostics\n"
+    "  --stats=json\n"
+    "             same, as JSON\n"
+    "  --time-passes\n"
+    "             print pass times only\n"
+    "  --lex-only only tokenize the input (for benchmarking)\n"
+    "  --max-errors N\n"
+    "             stop after N errors, 0 for no limit (default: 50)\n");
+  fprintf(fp, ""
+    "  --server SOCK\n"
+    "             serve assembly requests on a Unix socket\n"
+    "  --client SOCK ARGS...\n"
+    "             run `rvasm ARGS...` on a server\n");
+}
+
+
 /*
- * Main.
+ * Default dependency file: OUT with its extension replaced by .d
  */
-int main (int argc, char **argv)
+static char *dep_path (char *out)
+{
+  char *dot = strrchr(out, '.'), *slash = strrchr(out, '/'), *p;
+  size_t len = (dot && (!slash || dot > slash)) ? (size_t)(dot - out)
+                                                : strlen(out);
+  p = (char*)alloc(len + 3);
+  if (!p)
+    return NULL;
+  memcpy(p, out, len);
+  strcpy(p + len, ".d");
+  return p;
+}
+
+
+/* --gc-sections: roots, and where to report what was dropped */
+static int gc = 0;
+static char *gc_entry = NULL;
+static FILE *gc_msg = NULL;
+
+/* -O level */
+static int olevel = 0;
+
+/* files the last run wrote */
+static char *written[3];
+static int nwritten = 0;
+
+
+char **rvasm_outputs (int *n)
+{
+  *n = nwritten;
+  return written;
+}
+
+
+static int assemble (char **files, int nfiles, char *out, int debug)
+{
+  OutFile of;
+  rsz_t size;
+  int i, ok = 1;
+
+  perf_begin(T_PARSE);
+  for (i = 0; i < nfiles && !diag_full(); i++)
+    ok = rvasm_parse(files[i]) && ok;
+  perf_end(T_PARSE);
+  /* keep going, to report encoding errors too */
+  if (diag_full())
+    return 0;
+
+  if (ok && gc) {
+    perf_begin(T_LINK);
+    ok = rvasm_gc(gc_entry, gc_msg);
+    perf_end(T_LINK);
+  }
+
+  if (ok && olevel >= 2) {
+    perf_begin(T_OPT);
+    ok = rvasm_opt();
+    perf_end(T_OPT);
+  }
+
+  perf_begin(T_LAYOUT);
+  size = rvasm_layout();
+  perf_end(T_LAYOUT);
+
+  /* after parse errors, encode only to check for more errors. */
+  if (!ok) {
+    rvasm_encode(NULL);
+    return 0;
+  }
+
+  if (!out_open(&of, out, size)) {
+    diag_msg("could not open output file: %s", out);
+    return 0;
+  }
+  if (debug)
+    dbg_init();
+  perf_begin(T_ENCODE);
+  ok = rvasm_encode(of.fp);
+  perf_end(T_ENCODE);
+
+  perf_begin(T_OUTPUT);
+  /* after encoding errors this only drops the temporary file */
+  if (!out_commit(&of, ok) && ok) {
+    diag_msg("could not write output file: %s", out);
+    ok = 0;
+  }
+  if (ok && strcmp(out, "-") != 0)
+    written[nwritten++] = out;
+
+  if (ok && debug) {
+    char *dpath = (char*)alloc(strlen(out) + 5);
+    if (!dpath)
+      ok = 0;
+    else {
+      sprintf(dpath, "%s.dbg", out);
+      ok = dbg_write(dpath);
+      if (ok)
+        written[nwritten++] = dpath;
+    }
+  }
+  dbg_free();
+  perf_end(T_OUTPUT);
+  return ok;
+}
+
+
+int rvasm_run (int argc, char **argv, FILE *msg)
 {
-  if (argc < 2) {
-    printf(""
-      "usage: %s FILE...\n"
-      RVM_LABEL " Bytecode Assembler\n"
-      "Copyright (C) 2025  Vincent Yanzee J. Tan\n"
-      "This program is licensed under the GNU General Public\n"
-      "License v3 or later. See <https://www.gnu.org/licenses/>\n"
-      "for details.\n"
-      , argv[0]);
+  char *out = "a.out";
+  char **files;
+  int i, nfiles = 0, debug = 0, ok;
+  int stats = 0, json = 0, timers_only = 0, lex_only = 0;
+  int deps = 0, phony = 0;
+  char *depfile = NULL;
+  unsigned long max_errors = DEFMAXERRS;
+
+  gc = 0;
+  gc_entry = NULL;
+  gc_msg = NULL;
+  olevel = 0;
+  nwritten = 0;
+  files = (char**)malloc(sizeof(char*) * argc);
+  if (!files)
+    return 1;
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i+1 < argc)
+      out = argv[++i];
+    else if (strcmp(argv[i], "-g") == 0)
+      debug = 1;
+    else if (strcmp(argv[i], "-MD") == 0)
+      deps = 1;
+    else if (strcmp(argv[i], "-MF") == 0 && i+1 < argc)
+      depfile = argv[++i];
+    else if (strcmp(argv[i], "-MP") == 0)
+      phony = 1;
+    else if (strncmp(argv[i], "-O", 2) == 0 &&
+             strspn(argv[i] + 2, "0123456789") == strlen(argv[i] + 2))
+      olevel = argv[i][2] ? atoi(argv[i] + 2) : 1;
+    else if (strcmp(argv[i], "--stats") == 0)
+      stats = 1;
+    else if (strcmp(argv[i], "--stats=json") == 0)
+      stats = json = 1;
+    else if (strcmp(argv[i], "--time-passes") == 0)
+      stats = timers_only = 1;
+    else if (strcmp(argv[i], "--gc-sections") == 0)
+      gc = 1;
+    else if (strcmp(argv[i], "--print-gc-sections") == 0)
+      gc_msg = msg;
+    else if (strcmp(argv[i], "--entry") == 0 && i+1 < argc)
+      gc_entry = argv[++i];
+    else if (strcmp(argv[i], "--lex-only") == 0)
+      lex_only = 1;
+    else if (strcmp(argv[i], "--max-errors") == 0 && i+1 < argc)
+      max_errors = strtoul(argv[++i], NULL, 0);
+    else
+      files[nfiles++] = argv[i];
+  }
+  /* keep the image alone on stdout */
+  if (strcmp(out, "-") == 0) {
+    if (msg == stdout)
+      msg = stderr;
+    if (debug || (deps && !depfile)) {
+      fprintf(msg, "%s: -g and -MD need -o FILE\n", argv[0]);
+      free(files);
+      return 1;
+    }
+  }
+  if (nfiles == 0) {
+    usage(msg, argv[0]);
+    free(files);
     return 1;
   }
 
-  glob_mem = arena_new(0);
+  perf_reset();
+  if (stats)
+    perf_enable();
+  perf_begin(T_TOTAL);
+
+  arena_reset(glob_mem);
+  src_begin();
+  diag_init(max_errors);
+  ir_init();
+  sym_init();
+
+  if (lex_only) {
+    perf_begin(T_PARSE);
+    for (i = 0, ok = 1; i < nfiles; i++)
+      ok = rvasm_lex(files[i]) && ok;
+    perf_end(T_PARSE);
+  }
+  else
+    ok = assemble(files, nfiles, out, debug);
 
-  rvasm_parse(argv[1]);
+  if (ok && deps) {
+    if (!depfile)
+      depfile = dep_path(out);
+    ok = depfile && deps_write(depfile, out, phony, files, nfiles);
+    if (ok)
+      written[nwritten++] = depfile;
+  }
+
+  ir_free();
+  perf_end(T_TOTAL);
+  diag_flush(msg);
+  if (stats)
+    perf_report(msg, json, timers_only);
+
+  free(files);
+  return ok ? 0 : 1;
+}
+
+
+/*
+ * Main.
+ */
+int main (int argc, char **argv)
+{
+  int rc;
+  if (argc >= 3 && strcmp(argv[1], "--client") == 0)
+    return client_run(argv[2], argc - 3, argv + 3);
+
+  glob_mem = arena_new(0);
+  if (!glob_mem)
+    return 1;
+  if (argc == 3 && strcmp(argv[1], "--server") == 0)
+    rc = server_run(argv[2]);
+  else
+    rc = rvasm_run(argc, argv, stdout);
 
+  src_free();
   arena_free(glob_mem);
-  return 0;
+  return rc;
 }
@@ -20,10 +20,18 @@
 #define RVASM_H_   1
 
 #include <stddef.h>
+#include <stdio.h>
 #include "utils.h"
 
 #define TABSTOP     (4)
 #define MAXLSTCKSZ  (48)
+#define DEFMAXERRS  (50)
+
+#ifdef RVASM_FUZZING
+/* fuzz builds bound the work any one input can ask for */
+#define FUZZMAXTOKS  (1ul << 20)  /* replayed by .rept, .irp and macros */
+#define FUZZMAXSPACE (1ul << 16)  /* bytes of one .space or .align */
+#endif
 
 typedef unsigned long sloc_t; /* source loc */
 typedef unsigned long rpos_t; /* position in output binary */
@@ -35,13 +43,20 @@ typedef enum {
   TK_EOF,
   TK_NEWLN,
   TK_OPNAME,
-  TK_REG
+  TK_REG,
+  TK_NUM,
+  TK_IDENT,
+  TK_LABEL,
+  TK_DIRECTIVE,
+  TK_STR,
+  TK_PARAM    /* \name in a macro or .irp body */
 } TokenType;
 
 typedef struct {
   TokenType   tt;
   sloc_t   line, col, pos, len;
   char    *this_ln, *text, *fname;
+  long     val;   /* TK_NUM */
 } Token;
 
 typedef struct {
@@ -49,6 +64,12 @@ typedef struct {
   sloc_t   line, col, pos;
   int      end;
   Token    tok, lkahead;
+  /* replaying a stored body instead of lexing `src` */
+  Token    *toks;
+  unsigned long ntoks, ti;
+  unsigned long iter, niter;
+  Token    *args;   /* niter rows of nargs, for TK_PARAM */
+  int       nargs;
 } Lexer;
 
 void lex_init (Lexer *l, char *src, char *fname);
@@ -56,44 +77,177 @@ int lex_isact (Lexer *l);
 Token *lex_curr (Lexer *l);
 Token *lex_next (Lexer *l);
 Token *lex_peek (Lexer *l);
+size_t lex_str (Token *tok, char *out);
 
-void print_token (Token *tok, char *fmt, ...);
 signed int get_reg_idx (char *tok, int len);
 signed int get_opcode (char *tok, int len);
 
 
+typedef struct SrcFile SrcFile;
+struct SrcFile {
+  SrcFile *next;
+  char    *name;     /* as first named in this run */
+  char    *path;     /* canonical */
+  char    *text;     /* NUL-terminated, NULL once invalidated */
+  size_t   size;
+  unsigned long *lines;  /* line start offsets, built on demand */
+  unsigned long  nlines;
+  unsigned long  gen;    /* last run that opened it */
+};
+
+void src_begin (void);
+void src_onopen (void (*fn) (SrcFile *f));
+int src_used (SrcFile *f);
+SrcFile *src_open (char *name);
+SrcFile *src_note (char *name);
+SrcFile *src_find (char *name);
+SrcFile *src_bypath (char *path);
+SrcFile *src_list (void);
+void src_invalidate (SrcFile *f);
+char *src_line (SrcFile *f, sloc_t line, size_t *len);
+void src_free (void);
+
+
+int deps_write (char *path, char *target, int phony, char **files,
+                int nfiles);
+
+
+void diag_init (unsigned long max_errors);
+void diag_tok (Token *tok, char *fmt, ...);
+void diag_at (char *fname, sloc_t line, sloc_t col, sloc_t len,
+              char *fmt, ...);
+void diag_msg (char *fmt, ...);
+unsigned long diag_errors (void);
+int diag_full (void);
+int diag_flush (FILE *fp);
+
+
 void lst_free (void);
 Lexer *lst_curr (void);
 Lexer *lst_newf (char *fname, size_t nlen);
+Lexer *lst_newt (Token *toks, unsigned long ntoks, Token *args, int nargs,
+                 unsigned long niter);
 Lexer *lst_popf (void);
 
 
+typedef struct IRNode IRNode;
+typedef struct Symbol Symbol;
+
+typedef struct {
+  Token  *body;   /* in the arena, parameters resolved */
+  unsigned long ntoks;
+  int     nparams;
+} Macro;
+
+struct Symbol {
+  Symbol *next;   /* hash chain */
+  Symbol *link;   /* all symbols, in creation order */
+  char   *name;
+  size_t  len;
+  IRNode *def;    /* the IR_LABEL node, NULL if undefined */
+  IRNode *sect;   /* the IR_SECTION it is defined in */
+  Macro  *macro;  /* a macro of this name, NULL if none */
+};
+
+Symbol *sym_get (char *name, size_t len);
+Symbol *sym_list (void);
+void sym_init (void);
+
+
 typedef enum {
-  IR_INSTR
+  IR_INSTR,
+  IR_LABEL,
+  IR_DATA,    /* .byte .half .word .dword .ascii .asciz */
+  IR_SPACE,   /* .space, .align */
+  IR_INCBIN,
+  IR_SECTION  /* starts a unit of --gc-sections */
 } IRType;
 
 typedef struct {
   int     opc;
-  char    rgA;
-  char    rgB;
-  char    rgC;
+  signed char rgA;
+  signed char rgB;
+  signed char rgC;
+  long    imm;
+  Symbol *sym;    /* pc-relative target, if symbolic */
 } IRInst;
 
-typedef struct IRNode IRNode;
+typedef struct {
+  rsz_t   align;  /* pad up to a multiple of this, 0 for .space */
+  unsigned char fill;
+} IRSpace;
+
+/* a slice of a file, copied by the kernel when the image is written */
+typedef struct {
+  IRNode *link;   /* all .incbin nodes */
+  SrcFile *src;
+  int     fd;     /* opened when parsed, shared by nodes of one file */
+  int     own;    /* this node closes `fd` */
+  size_t  size;   /* of the file */
+  size_t  off;
+} IRBin;
+
+typedef struct {
+  char   *name;
+  int     live;
+} IRSect;
+
 struct IRNode {
   IRNode *next;
   IRType  type;
   rpos_t  loc;
   rsz_t   size;
+  char   *fname;
+  sloc_t  line, col;
   union {
-    IRInst i;
+    IRInst  i;
+    Symbol *label;
+    unsigned char *data;
+    IRSpace space;
+    IRBin   bin;
+    IRSect  sect;
   } val;
 };
 
+int mac_define (Lexer *l, Token *dir);
+int mac_repeat (Lexer *l, Token *dir, int irp);
+int mac_expand (Lexer *l, Token *name, Macro *m);
+
+
 void ir_init (void);
+void ir_free (void);
 IRNode *ir_push (void);
+IRNode *ir_list (void);
+void ir_cut (IRNode *prev, IRNode *last);
 
 int rvasm_parse (char *path);
+int rvasm_lex (char *path);
+rsz_t rvasm_layout (void);
+int rvasm_gc (char *entry, FILE *msg);
+int rvasm_opt (void);
+int rvasm_encode (FILE *out);
+
+
+typedef struct {
+  FILE *fp;
+  char *path;
+  char *tmp;    /* NULL for stdout */
+} OutFile;
+
+int out_open (OutFile *of, char *path, rsz_t size);
+int out_commit (OutFile *of, int ok);
+
+
+void dbg_init (void);
+void dbg_free (void);
+void dbg_line (rpos_t loc, char *fname, sloc_t line);
+int dbg_write (char *path);
+
+
+int rvasm_run (int argc, char **argv, FILE *msg);
+char **rvasm_outputs (int *n);
+int server_run (char *sock);
+int client_run (char *sock, int argc, char **argv);
 
 
 extern Arena *glob_mem;
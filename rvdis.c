@@ -19,25 +19,14 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "rvm/rvm.h"
+#include "isa.h"
+#include "rvdis.h"
 #include "utils.h"
 
 
-/*
- * Opcode to readabl mnemonic.
- */
-char *to_mnemonic (int op)
-{
-  switch (op) {
-#define DEF(op, idx) case (idx): return #op ;
-#include "rvm/opcodes.h"
-#undef DEF
-  default: return ".raw";
-  }
-}
-
-
 /*
  * Print register text.
  */
@@ -252,24 +241,86 @@ int disas_file (char *prog, char *path)
 }
 
 
+static void usage (char *prog)
+{
+  printf(""
+    "usage: %s [MODE] FILE...\n"
+    RVM_LABEL " Bytecode Disassembler\n"
+    "Copyright (C) 2025  Vincent Yanzee J. Tan\n"
+    "This program is licensed under the GNU General Public\n"
+    "License v3 or later. See <https://www.gnu.org/licenses/>\n"
+    "for details.\n"
+    , prog);
+  printf(""
+    "\n"
+    "A MODE applies to the files after it:\n"
+    "  --stats    print opcode, register, immediate, n-gram and\n"
+    "             basic block statistics as JSON\n"
+    "  --ndjson   print one JSON record per instruction\n"
+    "  --binary   write packed 24-byte records per instruction\n"
+    "  --source   interleave source lines from FILE.dbg\n"
+    "  --cost     estimate loop-weighted cost per function and block\n"
+    "  --diff A B compare two images block by block, ignoring moved\n"
+    "             branch targets; exits 1 if they differ\n");
+  printf(""
+    "\n"
+    "Options for --cost:\n"
+    "  --cost-table FILE\n"
+    "             per-opcode weights, \"MNEMONIC WEIGHT\" per line\n"
+    "  --top N    entries per table (default: 10)\n"
+    "  --loop-weight N\n"
+    "             cost multiplier per loop level (default: 10)\n");
+}
+
+
 /*
  * Main.
  */
 int main (int argc, char **argv)
 {
-  int i;
+  int i, ret = 0;
+  enum {
+    M_TEXT, M_STATS, M_NDJSON, M_BINARY, M_SOURCE, M_COST
+  } mode = M_TEXT;
   if (argc < 2) {
-    printf(""
-      "usage: %s FILE...\n"
-      RVM_LABEL " Bytecode Disassembler\n"
-      "Copyright (C) 2025  Vincent Yanzee J. Tan\n"
-      "This program is licensed under the GNU General Public\n"
-      "License v3 or later. See <https://www.gnu.org/licenses/>\n"
-      "for details.\n"
-      , argv[0]);
+    usage(argv[0]);
     return 1;
   }
-  for (i = 1; i < argc; i++)
-    disas_file(argv[0], argv[i]);
-  return 0;
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--stats") == 0)
+      mode = M_STATS;
+    else if (strcmp(argv[i], "--ndjson") == 0)
+      mode = M_NDJSON;
+    else if (strcmp(argv[i], "--binary") == 0)
+      mode = M_BINARY;
+    else if (strcmp(argv[i], "--source") == 0)
+      mode = M_SOURCE;
+    else if (strcmp(argv[i], "--cost") == 0)
+      mode = M_COST;
+    else if (strcmp(argv[i], "--diff") == 0 && i+2 < argc) {
+      int r = diff_files(argv[0], argv[i+1], argv[i+2]);
+      if (r > ret)
+        ret = r;
+      i += 2;
+    }
+    else if (strcmp(argv[i], "--cost-table") == 0 && i+1 < argc) {
+      if (!cost_load(argv[0], argv[++i]))
+        return 1;
+    }
+    else if (strcmp(argv[i], "--top") == 0 && i+1 < argc)
+      cost_set(strtoul(argv[++i], NULL, 0), 0);
+    else if (strcmp(argv[i], "--loop-weight") == 0 && i+1 < argc)
+      cost_set(0, strtoul(argv[++i], NULL, 0));
+    else if (mode == M_STATS)
+      stats_file(argv[0], argv[i]);
+    else if (mode == M_SOURCE)
+      source_file(argv[0], argv[i]);
+    else if (mode == M_COST)
+      cost_file(argv[0], argv[i]);
+    else if (mode == M_NDJSON || mode == M_BINARY)
+      dump_file(argv[0], argv[i], mode == M_BINARY);
+    else
+      disas_file(argv[0], argv[i]);
+  }
+  return ret;
 }
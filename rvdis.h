@@ -0,0 +1,96 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RVDIS_H_
+#define RVDIS_H_   1
+
+#include "rvm/rvm.h"
+
+typedef struct {
+  char *name;
+  char *text;            /* loaded on first use */
+  unsigned long *lines;  /* line start offsets */
+  unsigned long nlines;
+  int failed;
+} DbgFile;
+
+typedef struct {
+  unsigned long addr;
+  char *name;
+} DbgSym;
+
+typedef struct {
+  unsigned long pc;      /* word index */
+  unsigned long file;
+  unsigned long line;
+} DbgRow;
+
+typedef struct {
+  DbgFile *files;
+  DbgSym  *syms;         /* sorted by address */
+  DbgRow  *rows;         /* sorted by pc */
+  unsigned long nfiles, nsyms, nrows;
+} DbgInfo;
+
+/*
+ * Print an instruction. `pc` is the 1-based word index.
+ */
+void print_inst (unsigned long pc, rvm_inst_t i);
+
+/*
+ * Print static statistics of an image as JSON.
+ */
+int stats_file (char *prog, char *path);
+
+/*
+ * Print one record per instruction, as NDJSON or as packed binary
+ * records (see ddump.c for the layout).
+ */
+int dump_file (char *prog, char *path, int binary);
+
+/*
+ * Static cost report, see dcost.c. cost_load() applies a cost table,
+ * cost_set() the report length and loop weight (0 keeps the current).
+ */
+int cost_load (char *prog, char *path);
+void cost_set (unsigned long top, unsigned long loopw);
+int cost_file (char *prog, char *path);
+
+/*
+ * Structural diff of two images, see ddiff.c. Returns 0 when they
+ * match, 1 when they differ and 2 on error.
+ */
+int diff_files (char *prog, char *path_a, char *path_b);
+
+/*
+ * Loads a `.dbg` sidecar. Returns 0 on failure.
+ */
+int dbg_load (DbgInfo *di, char *path);
+void dbg_unload (DbgInfo *di);
+
+/*
+ * Finds the row covering `pc` (a word index), or -1.
+ */
+long dbg_find (DbgInfo *di, unsigned long pc);
+
+/*
+ * Disassemble with interleaved source lines from `<path>.dbg`.
+ */
+int source_file (char *prog, char *path);
+
+#endif /* RVDIS_H_ */
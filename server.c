@@ -0,0 +1,589 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Persistent assembler server.
+ *
+ * `rvasm --server SOCK` keeps the arena, the loaded source files and
+ * the result of every unit it has assembled, where a unit is one
+ * distinct (cwd, arguments) request. The directories of loaded files
+ * are watched with inotify: a change drops that file's cached text and
+ * reassembles only the units that read it, so requests for untouched
+ * units are answered from memory. If the kernel drops events, every
+ * file counts as changed. Failed units always rerun, and so do
+ * units whose outputs were removed or changed behind the server's back.
+ * The image can't go to stdout (`-o -`), which belongs to the server.
+ *
+ * One request per connection, integers are u32 little endian:
+ *   request:  len, then `len` bytes of "cwd\0arg\0arg\0..."
+ *   reply:    status, len, then `len` bytes of diagnostics
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "rvasm.h"
+
+#define MAXREQSZ  (1ul << 20)
+#define MAXARGS   (256)
+#define MAXOUTS   (3)     /* image, .dbg, dependency file */
+#define IOTIMEOUT (5)     /* seconds to send a request or take a reply */
+
+typedef struct {
+  char       *path;       /* absolute */
+  struct stat st;         /* as the run left it */
+} Output;
+
+typedef struct Unit Unit;
+struct Unit {
+  Unit     *next;
+  char     *key;            /* request payload */
+  size_t    keylen;
+  int       argc;
+  char     *argv[MAXARGS];  /* "rvasm", then into key */
+  SrcFile **deps;
+  unsigned long ndeps;
+  int       status;
+  char     *msg;
+  size_t    msglen;
+  Output    outs[MAXOUTS];
+  int       nouts;
+  int       dirty;
+};
+
+typedef struct Watch Watch;
+struct Watch {
+  Watch *next;
+  int    wd;
+  char  *dir;
+};
+
+static Unit *units = NULL;
+static Watch *watches = NULL;
+static int ifd = -1;
+
+
+static void put32 (unsigned char *p, unsigned long v)
+{
+  p[0] = (unsigned char)v;
+  p[1] = (unsigned char)(v >> 8);
+  p[2] = (unsigned char)(v >> 16);
+  p[3] = (unsigned char)(v >> 24);
+}
+
+
+static unsigned long get32 (unsigned char *p)
+{
+  return (unsigned long)p[0] | (unsigned long)p[1] << 8 |
+         (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+
+
+static int read_all (int fd, void *buf, size_t sz)
+{
+  char *p = (char*)buf;
+  while (sz) {
+    ssize_t n = read(fd, p, sz);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 0;
+    p += n;
+    sz -= (size_t)n;
+  }
+  return 1;
+}
+
+
+/*
+ * read_all() by `end`. Requests are served one at a time, so a client
+ * that stalls or trickles must not hold up the others for long.
+ */
+static int read_until (int fd, void *buf, size_t sz, time_t end)
+{
+  char *p = (char*)buf;
+  while (sz) {
+    struct pollfd pfd;
+    ssize_t n;
+    time_t left = end - time(NULL);
+    if (left <= 0)
+      return 0;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    n = poll(&pfd, 1, (int)left * 1000);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 0;
+    n = read(fd, p, sz);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 0;
+    p += n;
+    sz -= (size_t)n;
+  }
+  return 1;
+}
+
+
+static int write_all (int fd, const void *buf, size_t sz)
+{
+  const char *p = (const char*)buf;
+  while (sz) {
+    ssize_t n = write(fd, p, sz);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return 0;
+    p += n;
+    sz -= (size_t)n;
+  }
+  return 1;
+}
+
+
+static int sock_addr (struct sockaddr_un *sa, char *path)
+{
+  memset(sa, 0, sizeof(*sa));
+  sa->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(sa->sun_path)) {
+    fprintf(stderr, "rvasm: socket path too long: %s\n", path);
+    return 0;
+  }
+  strcpy(sa->sun_path, path);
+  return 1;
+}
+
+
+#ifdef __linux__
+/*
+ * Called as a run names each file, before it is read, so no change
+ * made after the read can go unseen.
+ */
+static void watch_dir (SrcFile *f)
+{
+  char *slash = strrchr(f->path, '/');
+  size_t len;
+  Watch *w;
+
+  if (ifd < 0 || !slash)
+    return;
+  len = slash == f->path ? 1 : (size_t)(slash - f->path);
+  for (w = watches; w; w = w->next)
+    if (strlen(w->dir) == len && strncmp(w->dir, f->path, len) == 0)
+      return;
+
+  w = (Watch*)malloc(sizeof(Watch));
+  if (!w)
+    return;
+  w->dir = (char*)malloc(len + 1);
+  if (!w->dir) {
+    free(w);
+    return;
+  }
+  memcpy(w->dir, f->path, len);
+  w->dir[len] = '\0';
+  /* editors tend to replace files, so watch the directory */
+  w->wd = inotify_add_watch(ifd, w->dir, IN_CLOSE_WRITE | IN_MOVED_TO |
+                            IN_CREATE | IN_DELETE);
+  if (w->wd < 0) {
+    free(w->dir);
+    free(w);
+    return;
+  }
+  w->next = watches;
+  watches = w;
+}
+#endif
+
+
+/*
+ * Remembers what the run wrote. Paths are relative to the unit's cwd.
+ */
+static void note_outputs (Unit *u)
+{
+  char **paths;
+  int i, n;
+
+  for (i = 0; i < u->nouts; i++)
+    free(u->outs[i].path);
+  u->nouts = 0;
+  paths = rvasm_outputs(&n);
+  for (i = 0; i < n && i < MAXOUTS; i++) {
+    size_t kl = strlen(u->key), pl = strlen(paths[i]);
+    Output *o = &u->outs[u->nouts];
+    o->path = (char*)malloc(kl + pl + 2);
+    if (!o->path) {
+      u->dirty = 1;
+      return;
+    }
+    if (paths[i][0] == '/')
+      memcpy(o->path, paths[i], pl + 1);
+    else {
+      memcpy(o->path, u->key, kl);
+      o->path[kl] = '/';
+      memcpy(o->path + kl + 1, paths[i], pl + 1);
+    }
+    u->nouts++;
+    if (stat(o->path, &o->st) != 0)
+      u->dirty = 1;
+  }
+}
+
+
+/*
+ * Non-zero if an output is gone, or isn't the file the run wrote.
+ */
+static int outputs_changed (Unit *u)
+{
+  struct stat st;
+  int i;
+  for (i = 0; i < u->nouts; i++) {
+    Output *o = &u->outs[i];
+    if (stat(o->path, &st) != 0 || st.st_dev != o->st.st_dev ||
+        st.st_ino != o->st.st_ino || st.st_size != o->st.st_size ||
+        st.st_mtim.tv_sec != o->st.st_mtim.tv_sec ||
+        st.st_mtim.tv_nsec != o->st.st_mtim.tv_nsec)
+      return 1;
+  }
+  return 0;
+}
+
+
+/*
+ * `-o -` would write the image to the server's own stdout.
+ */
+static int to_stdout (Unit *u)
+{
+  int i;
+  for (i = 1; i + 1 < u->argc; i++) {
+    if (strcmp(u->argv[i], "-o") == 0 && strcmp(u->argv[i+1], "-") == 0)
+      return 1;
+    if (strcmp(u->argv[i], "-o") == 0 || strcmp(u->argv[i], "-MF") == 0 ||
+        strcmp(u->argv[i], "--entry") == 0 ||
+        strcmp(u->argv[i], "--max-errors") == 0)
+      i++;
+  }
+  return 0;
+}
+
+
+static void run_unit (Unit *u)
+{
+  FILE *msg;
+  SrcFile *f;
+  unsigned long n;
+
+  free(u->msg);
+  u->msg = NULL;
+  u->msglen = 0;
+  msg = open_memstream(&u->msg, &u->msglen);
+  if (!msg) {
+    u->status = 1;
+    return;
+  }
+  if (to_stdout(u)) {
+    fprintf(msg, "rvasm: -o - is not supported with --client\n");
+    u->status = 1;
+  }
+  else if (chdir(u->key) != 0) {
+    fprintf(msg, "rvasm: cannot enter %s\n", u->key);
+    u->status = 1;
+  }
+  else
+    u->status = rvasm_run(u->argc, u->argv, msg);
+  fclose(msg);
+
+  /* remember what it read */
+  free(u->deps);
+  u->deps = NULL;
+  for (n = 0, f = src_list(); f; f = f->next)
+    n += src_used(f);
+  u->ndeps = 0;
+  if (n)
+    u->deps = (SrcFile**)malloc(n * sizeof(SrcFile*));
+  for (f = src_list(); f && u->deps; f = f->next)
+    if (src_used(f))
+      u->deps[u->ndeps++] = f;
+  u->dirty = u->status != 0 || (n && !u->deps);
+  note_outputs(u);
+}
+
+
+static Unit *get_unit (char *key, size_t keylen)
+{
+  Unit *u;
+  char *p, *end;
+
+  for (u = units; u; u = u->next)
+    if (u->keylen == keylen && memcmp(u->key, key, keylen) == 0)
+      return u;
+
+  u = (Unit*)calloc(1, sizeof(Unit));
+  if (!u)
+    return NULL;
+  u->key = key;
+  u->keylen = keylen;
+  u->argv[u->argc++] = "rvasm";
+  end = key + keylen;
+  for (p = key + strlen(key) + 1; p < end && u->argc < MAXARGS - 1;
+       p += strlen(p) + 1)
+    u->argv[u->argc++] = p;
+  u->argv[u->argc] = NULL;
+  u->dirty = 1;
+  u->next = units;
+  units = u;
+  return u;
+}
+
+
+static void serve (int fd)
+{
+  unsigned char hdr[8];
+  unsigned long len;
+  time_t end = time(NULL) + IOTIMEOUT;
+  struct timeval tv;
+  char *key;
+  Unit *u;
+
+  /* and a reader that stalls */
+  tv.tv_sec = IOTIMEOUT;
+  tv.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  if (!read_until(fd, hdr, 4, end))
+    return;
+  len = get32(hdr);
+  if (len == 0 || len > MAXREQSZ)
+    return;
+  key = (char*)malloc(len);
+  if (!key)
+    return;
+  if (!read_until(fd, key, len, end) || key[len-1] != '\0') {
+    free(key);
+    return;
+  }
+
+  u = get_unit(key, len);
+  if (u != NULL && u->key != key)
+    free(key);
+  if (!u) {
+    free(key);
+    return;
+  }
+  if (u->dirty || outputs_changed(u))
+    run_unit(u);
+
+  put32(hdr, (unsigned long)u->status);
+  put32(hdr + 4, (unsigned long)u->msglen);
+  if (write_all(fd, hdr, 8) && u->msglen)
+    write_all(fd, u->msg, u->msglen);
+}
+
+
+#ifdef __linux__
+/*
+ * Drop changed files and reassemble the units that read them.
+ */
+static void on_change (void)
+{
+  char buf[4096], path[4096];
+  ssize_t n;
+  Unit *u;
+
+  while ((n = read(ifd, buf, sizeof(buf))) > 0) {
+    char *p = buf;
+    while (p < buf + n) {
+      struct inotify_event *ev = (struct inotify_event*)(void*)p;
+      Watch *w;
+      SrcFile *f;
+      unsigned long i;
+      size_t dl, nl;
+
+      p += sizeof(struct inotify_event) + ev->len;
+      /* events were dropped, so any file may have changed */
+      if (ev->mask & IN_Q_OVERFLOW) {
+        for (f = src_list(); f; f = f->next)
+          src_invalidate(f);
+        for (u = units; u; u = u->next)
+          u->dirty = 1;
+        continue;
+      }
+      if (!ev->len)
+        continue;
+      for (w = watches; w && w->wd != ev->wd; w = w->next)
+        ;
+      if (!w)
+        continue;
+      dl = strcmp(w->dir, "/") ? strlen(w->dir) : 0;
+      nl = strlen(ev->name);
+      if (dl + nl + 2 > sizeof(path))
+        continue;
+      memcpy(path, w->dir, dl);
+      path[dl] = '/';
+      memcpy(path + dl + 1, ev->name, nl + 1);
+      f = src_bypath(path);
+      if (!f)
+        continue;
+      src_invalidate(f);
+      for (u = units; u; u = u->next)
+        for (i = 0; i < u->ndeps; i++)
+          if (u->deps[i] == f)
+            u->dirty = 1;
+    }
+  }
+
+  for (u = units; u; u = u->next)
+    if (u->dirty && u->status == 0)
+      run_unit(u);
+}
+#endif
+
+
+int server_run (char *sock)
+{
+  struct sockaddr_un sa;
+  struct pollfd pfd[2];
+  int lfd, npfd = 1;
+
+  if (!sock_addr(&sa, sock))
+    return 1;
+  signal(SIGPIPE, SIG_IGN);
+  lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (lfd < 0) {
+    perror("rvasm: socket");
+    return 1;
+  }
+  unlink(sock);
+  if (bind(lfd, (struct sockaddr*)&sa, sizeof(sa)) != 0 ||
+      listen(lfd, 16) != 0) {
+    perror("rvasm: bind");
+    close(lfd);
+    return 1;
+  }
+  pfd[0].fd = lfd;
+  pfd[0].events = POLLIN;
+#ifdef __linux__
+  ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (ifd >= 0) {
+    src_onopen(watch_dir);
+    pfd[1].fd = ifd;
+    pfd[1].events = POLLIN;
+    npfd = 2;
+  }
+#endif
+
+  for (;;) {
+    if (poll(pfd, (nfds_t)npfd, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("rvasm: poll");
+      break;
+    }
+#ifdef __linux__
+    if (npfd > 1 && (pfd[1].revents & POLLIN))
+      on_change();
+#endif
+    if (pfd[0].revents & POLLIN) {
+      int fd = accept(lfd, NULL, NULL);
+      if (fd >= 0) {
+        serve(fd);
+        close(fd);
+      }
+    }
+  }
+
+  close(lfd);
+  unlink(sock);
+  return 1;
+}
+
+
+int client_run (char *sock, int argc, char **argv)
+{
+  struct sockaddr_un sa;
+  unsigned char hdr[8];
+  char cwd[4096], *req, *p;
+  unsigned long len, status;
+  size_t sz;
+  int i, fd, ok;
+
+  if (!sock_addr(&sa, sock))
+    return 1;
+  if (!getcwd(cwd, sizeof(cwd))) {
+    perror("rvasm: getcwd");
+    return 1;
+  }
+  sz = strlen(cwd) + 1;
+  for (i = 0; i < argc; i++)
+    sz += strlen(argv[i]) + 1;
+  req = (char*)malloc(sz + 4);
+  if (!req)
+    return 1;
+  put32((unsigned char*)req, (unsigned long)sz);
+  p = req + 4;
+  strcpy(p, cwd);
+  p += strlen(cwd) + 1;
+  for (i = 0; i < argc; i++) {
+    strcpy(p, argv[i]);
+    p += strlen(argv[i]) + 1;
+  }
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+    perror("rvasm: connect");
+    free(req);
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+  ok = write_all(fd, req, sz + 4) && read_all(fd, hdr, 8);
+  free(req);
+  if (!ok) {
+    fprintf(stderr, "rvasm: no reply from server\n");
+    close(fd);
+    return 1;
+  }
+  status = get32(hdr);
+  for (len = get32(hdr + 4); len; ) {
+    char buf[4096];
+    size_t n = len < sizeof(buf) ? (size_t)len : sizeof(buf);
+    if (!read_all(fd, buf, n))
+      break;
+    fwrite(buf, 1, n, stdout);
+    len -= n;
+  }
+  close(fd);
+  return (int)status;
+}
@@ -0,0 +1,218 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Loaded source files. They outlive a single assembly so a server can
+ * keep them cached; each run starts a new generation with src_begin()
+ * and only the files touched in the current one count as its inputs.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef RVASM_FUZZING
+#include <sys/stat.h>
+#endif
+
+#include "rvasm.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX  (4096)
+#endif
+
+static SrcFile *src_head = NULL, *src_tail = NULL;
+static SrcFile *src_last = NULL;  /* last src_find() hit */
+static unsigned long src_gen = 0;
+static void (*src_hook) (SrcFile *f) = NULL;
+
+
+static char *dup_str (char *s)
+{
+  char *d = (char*)malloc(strlen(s) + 1);
+  if (d)
+    strcpy(d, s);
+  return d;
+}
+
+
+void src_begin (void)
+{
+  src_gen++;
+  src_last = NULL;
+}
+
+
+void src_onopen (void (*fn) (SrcFile *f))
+{
+  src_hook = fn;
+}
+
+
+int src_used (SrcFile *f)
+{
+  return f->gen == src_gen;
+}
+
+
+static int src_load (SrcFile *f)
+{
+#ifdef RVASM_FUZZING
+  /* /dev/zero and pipes may never end */
+  struct stat st;
+  if (stat(f->path, &st) != 0 || !S_ISREG(st.st_mode))
+    return 0;
+#endif
+  f->text = read_ascii_file(f->path, &f->size);
+  return f->text != NULL;
+}
+
+
+/*
+ * Finds or registers `name`, and counts it as used by this run.
+ */
+static SrcFile *src_enter (char *name)
+{
+  char buf[PATH_MAX];
+  SrcFile *f;
+
+  /* cached under the canonical path, e.g. included twice */
+  if (!realpath(name, buf))
+    return NULL;
+  for (f = src_head; f; f = f->next)
+    if (strcmp(f->path, buf) == 0)
+      break;
+
+  if (!f) {
+    f = (SrcFile*)calloc(1, sizeof(SrcFile));
+    if (!f)
+      return NULL;
+    f->path = dup_str(buf);
+    if (!f->path) {
+      free(f);
+      return NULL;
+    }
+    if (src_tail)
+      src_tail->next = f;
+    else
+      src_head = f;
+    src_tail = f;
+  }
+
+  /* show it as this run first named it */
+  if (f->gen != src_gen || !f->name) {
+    if (!f->name || strcmp(f->name, name) != 0) {
+      char *n = dup_str(name);
+      if (!n)
+        return NULL;
+      free(f->name);
+      f->name = n;
+    }
+    f->gen = src_gen;
+  }
+  /* before it is read, so the server sees any later change */
+  if (src_hook)
+    src_hook(f);
+  return f;
+}
+
+
+SrcFile *src_open (char *name)
+{
+  SrcFile *f = src_enter(name);
+  if (!f || (!f->text && !src_load(f)))
+    return NULL;
+  return f;
+}
+
+
+SrcFile *src_note (char *name)
+{
+  return src_enter(name);
+}
+
+
+SrcFile *src_list (void)
+{
+  return src_head;
+}
+
+
+SrcFile *src_find (char *name)
+{
+  SrcFile *f;
+  if (src_last && src_last->name == name)
+    return src_last;
+  for (f = src_head; f; f = f->next)
+    if (f->name == name)
+      return src_last = f;
+  for (f = src_head; f; f = f->next)
+    if (f->name && strcmp(f->name, name) == 0)
+      return src_last = f;
+  return NULL;
+}
+
+
+SrcFile *src_bypath (char *path)
+{
+  SrcFile *f;
+  for (f = src_head; f; f = f->next)
+    if (strcmp(f->path, path) == 0)
+      return f;
+  return NULL;
+}
+
+
+void src_invalidate (SrcFile *f)
+{
+  free(f->text);
+  free(f->lines);
+  f->text = NULL;
+  f->lines = NULL;
+  f->size = 0;
+  f->nlines = 0;
+}
+
+
+/*
+ * Line start offsets are built on first lookup.
+ */
+char *src_line (SrcFile *f, sloc_t line, size_t *len)
+{
+  if (!f->text)
+    return NULL;
+  if (!f->lines && !(f->lines = line_index(f->text, f->size, &f->nlines)))
+    return NULL;
+  return line_get(f->text, f->lines, f->nlines, line, len);
+}
+
+
+void src_free (void)
+{
+  SrcFile *f, *next;
+  for (f = src_head; f; f = next) {
+    next = f->next;
+    src_invalidate(f);
+    free(f->name);
+    free(f->path);
+    free(f);
+  }
+  src_head = src_tail = src_last = NULL;
+}
@@ -0,0 +1,120 @@
+/*
+ *  rvasm -- An assembler and disassembler for rvm.
+ *  Copyright (C) 2025  Vincent Yanzee J. Tan
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rvasm.h"
+
+#define SYMTABSZ  (4096)   /* initial size, power of 2 */
+
+static Symbol **sym_tab = NULL;
+static unsigned long sym_cap = 0, sym_cnt = 0;
+static Symbol *sym_head = NULL, *sym_tail = NULL;
+
+
+static unsigned long sym_hash (char *name, size_t len)
+{
+  /* FNV-1a */
+  unsigned long h = 2166136261ul;
+  while (len--) {
+    h ^= (unsigned char)*name++;
+    h *= 16777619ul;
+  }
+  return h;
+}
+
+
+void sym_init (void)
+{
+  if (!sym_tab) {
+    sym_tab = (Symbol**)malloc(SYMTABSZ * sizeof(Symbol*));
+    sym_cap = sym_tab ? SYMTABSZ : 0;
+  }
+  if (sym_tab)
+    memset(sym_tab, 0, sym_cap * sizeof(Symbol*));
+  sym_cnt = 0;
+  sym_head = sym_tail = NULL;
+}
+
+
+/*
+ * Doubles the table once it is full, keeping chains short however
+ * many labels a program has. Failing to grow only slows lookups.
+ */
+static void sym_grow (void)
+{
+  unsigned long cap = sym_cap * 2;
+  Symbol **tab = (Symbol**)calloc(cap, sizeof(Symbol*));
+  Symbol *sym;
+  if (!tab)
+    return;
+  for (sym = sym_head; sym; sym = sym->link) {
+    Symbol **slot = &tab[sym_hash(sym->name, sym->len) & (cap-1)];
+    sym->next = *slot;
+    *slot = sym;
+  }
+  free(sym_tab);
+  sym_tab = tab;
+  sym_cap = cap;
+}
+
+
+Symbol *sym_get (char *name, size_t len)
+{
+  Symbol **slot, *sym;
+
+  if (!sym_tab)
+    return NULL;
+  slot = &sym_tab[sym_hash(name, len) & (sym_cap-1)];
+  for (sym = *slot; sym; sym = sym->next)
+    if (sym->len == len && memcmp(sym->name, name, len) == 0)
+      return sym;
+
+  /* not found, make one. */
+  sym = (Symbol*)alloc(sizeof(Symbol));
+  if (!sym)
+    return NULL;
+  sym->name = (char*)alloc(len+1);
+  if (!sym->name)
+    return NULL;
+  memcpy(sym->name, name, len);
+  sym->name[len] = '\0';
+  sym->len = len;
+  sym->def = NULL;
+  sym->sect = NULL;
+  sym->macro = NULL;
+  sym->next = *slot;
+  sym->link = NULL;
+  *slot = sym;
+  if (sym_tail)
+    sym_tail->link = sym;
+  else
+    sym_head = sym;
+  sym_tail = sym;
+  if (++sym_cnt > sym_cap)
+    sym_grow();
+  return sym;
+}
+
+
+Symbol *sym_list (void)
+{
+  return sym_head;
+}
@@ -0,0 +1,487 @@
+#!/bin/sh
+#
+#  rvasm -- An assembler and disassembler for rvm.
+#  Copyright (C) 2025  Vincent Yanzee J. Tan
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+# Regression tests, run by `make check`.
+#
+# Each case assembles a small source and checks the image or the
+# diagnostics. Build with CC="gcc -fsanitize=address,undefined" to
+# also catch memory errors.
+
+dir=$(dirname "$0")
+work=$dir/out
+top=$(pwd)
+fail=0
+
+mkdir -p "$work"
+
+pass () { echo "ok    $1"; }
+bad () { echo "FAIL  $1"; fail=1; }
+
+# ARGS...: assembles with ./rvasm, output in $work/log
+# (run from the top directory, as make does)
+asm () { ./rvasm "$@" > "$work/log" 2>&1; }
+
+# FILE: size in bytes
+size () { wc -c < "$1" | tr -d ' '; }
+
+
+# rvdis --stats: counts, trap immediates, n-grams only within blocks
+cat > "$work/stats.S" <<'SRC'
+a:	inc r1
+	call a
+	trap #5
+	li r2, #300
+b:	dec r1
+	jne b
+	ret
+SRC
+if asm -o "$work/stats.bin" "$work/stats.S" &&
+   ./rvdis --stats "$work/stats.bin" > "$work/stats" &&
+   grep -q '"insts": 7,' "$work/stats" &&
+   grep -q '"trap": 1, "li": 1,' "$work/stats" &&
+   grep -q '"trap": \[0, 0, 0, 1, 0,' "$work/stats" &&
+   grep -q '"seq": \["trap", "li"\], "count": 1' "$work/stats" &&
+   ! grep -q '"call", "trap"' "$work/stats" &&
+   ! grep -q '"li", "dec"' "$work/stats" &&
+   grep -q '"blocks": {"count": 4, "lengths": {"1": 1, "2-3": 3}}' \
+     "$work/stats"; then
+  pass stats
+else
+  bad stats
+fi
+
+
+# rvdis --ndjson and --binary: one decoded record per instruction
+printf '\tli r2, #-3\n\tj #-1\n' > "$work/dump.S"
+cat > "$work/dump.want" <<'OUT'
+{"pc":0,"raw":805304836,"op":"li","opc":4,"fmt":"ri19","ra":2,"imms":-3,"immu":524285}
+{"pc":4,"raw":4294966820,"op":"j","opc":36,"fmt":"pc23","imms":-1,"immu":8388607,"target":4}
+OUT
+if asm -o "$work/dump.bin" "$work/dump.S" &&
+   ./rvdis --ndjson "$work/dump.bin" > "$work/dump.got" &&
+   cmp -s "$work/dump.want" "$work/dump.got"; then
+  pass ndjson
+else
+  bad ndjson
+fi
+# the header, then the li record: pc, raw, opc, fmt, ra, rb, rc,
+# immbits, pad, imms, immu
+want="52 56 44 52 01 00 00 00 18 00 00 00 02 00 00 00"
+want="$want 00 00 00 00 04 fa ff 2f 04 00 03 02 ff ff 13 00"
+want="$want fd ff ff ff fd ff 07 00"
+if ./rvdis --binary "$work/dump.bin" > "$work/dump.rec" &&
+   [ "$(size "$work/dump.rec")" = 64 ] &&
+   [ "$(od -An -tx1 -v -N40 "$work/dump.rec" | tr -s ' \n' ' ' |
+        sed 's/^ //; s/ $//')" = "$want" ]; then
+  pass binary
+else
+  bad binary
+fi
+
+
+# rvasm -g and rvdis --source: each source line before its code,
+# across an include
+printf 'f:\tinc r1\n\tret\n' > "$work/src.inc"
+printf 'main:\tli r1, #2\n.include "src.inc"\n\tcall f\n' > "$work/src.S"
+printf 'src.S:1:\tmain:\tli r1, #2\nsrc.inc:1:\tf:\tinc r1\n' \
+  > "$work/src.want"
+printf 'src.inc:2:\t\tret\nsrc.S:3:\t\tcall f\n' >> "$work/src.want"
+if (cd "$work" && "$top/rvasm" -g -o src.bin src.S) > "$work/log" 2>&1 &&
+   (cd "$work" && "$top/rvdis" --source src.bin) > "$work/src.out" &&
+   grep '^src\.' "$work/src.out" > "$work/src.got" &&
+   cmp -s "$work/src.want" "$work/src.got" &&
+   grep -q '^00000004 <f>:$' "$work/src.out"; then
+  pass source
+else
+  bad source
+fi
+
+
+# --stats counts both files, --stats=json says the same, and
+# --time-passes prints the timers only
+want='"counters": {"files": 2, "bytes": 58, "lines": 5, "tokens": 17,'
+if (cd "$work" && "$top/rvasm" --stats -o src.bin src.S) > "$work/log" 2>&1 &&
+   awk '$1 == "files" && $2 == 2 { n++ } $1 == "lines" && $2 == 5 { n++ }
+        $1 == "tokens" && $2 == 17 { n++ }
+        $1 == "include_depth" && $2 == 2 { n++ }
+        END { exit n != 4 }' "$work/log" &&
+   (cd "$work" && "$top/rvasm" --stats=json -o src.bin src.S) \
+     > "$work/log" 2>&1 &&
+   grep -q "$want" "$work/log" &&
+   (cd "$work" && "$top/rvasm" --time-passes -o src.bin src.S) \
+     > "$work/log" 2>&1 &&
+   [ "$(grep -c '^[a-z]* *[0-9][0-9.]*$' "$work/log")" = 9 ] &&
+   ! grep -q counter "$work/log"; then
+  pass stats-asm
+else
+  bad stats-asm
+fi
+
+
+# errors are reported in order, each line recovered from, until
+# --max-errors
+cat > "$work/recover.S" <<'SRC'
+	li r1
+	foo r2
+	nop
+	mov r1, #3
+	j nowhere
+	ret
+SRC
+if ! asm -o "$work/recover.bin" "$work/recover.S" &&
+   [ "$(grep -c 'error:' "$work/log")" = 4 ] &&
+   [ "$(grep 'error:' "$work/log" | cut -d: -f2 | tr '\n' ' ')" = \
+     "1 2 4 5 " ] &&
+   ! [ -e "$work/recover.bin" ] &&
+   ! asm --max-errors 2 -o "$work/recover.bin" "$work/recover.S" &&
+   [ "$(grep -c 'error:' "$work/log")" = 3 ] &&
+   grep -q "too many errors, stopping" "$work/log"; then
+  pass recovery
+else
+  bad recovery
+fi
+
+
+# NOPERF=1: the same image, and --stats says it has nothing to report
+if test/rvasm-noperf --stats -o "$work/noperf.bin" "$work/stats.S" \
+     > "$work/log" 2>&1 &&
+   cmp -s "$work/stats.bin" "$work/noperf.bin" &&
+   grep -q "built without instrumentation" "$work/log"; then
+  pass noperf
+else
+  bad noperf
+fi
+
+
+# -MD -MP: every file opened, escaped for make, and a phony rule for
+# each include but none for the inputs
+mkdir -p "$work/dep"
+for f in 'sp ace' 'h#sh' 'd$l' 'b\sl'; do
+  printf '\tnop\n' > "$work/dep/$f.inc"
+done
+printf '.include "sp ace.inc"\n.include "h#sh.inc"\n' > "$work/dep/m1.S"
+printf '.include "d$l.inc"\n.include "b\\\\sl.inc"\n' > "$work/dep/m2.S"
+printf '.include "m1.S"\n' >> "$work/dep/m2.S"
+cat > "$work/dep.want" <<'OUT'
+o.bin: \
+  @D@/m1.S \
+  @D@/sp\ ace.inc \
+  @D@/h\#sh.inc \
+  @D@/m2.S \
+  @D@/d$$l.inc \
+  @D@/b\sl.inc
+
+@D@/sp\ ace.inc:
+
+@D@/h\#sh.inc:
+
+@D@/d$$l.inc:
+
+@D@/b\sl.inc:
+OUT
+d=$(cd "$work/dep" && pwd -P)
+sed "s|@D@|$d|" "$work/dep.want" > "$work/dep/want"
+rm -f "$work/dep/o.d" "$work/dep/deps"
+if (cd "$work/dep" && "$top/rvasm" -MD -MP -o o.bin m1.S m2.S) \
+     > "$work/log" 2>&1 &&
+   cmp -s "$work/dep/want" "$work/dep/o.d" &&
+   (cd "$work/dep" && "$top/rvasm" -MD -MF deps -o o.bin m1.S) \
+     > "$work/log" 2>&1 &&
+   [ "$(sed -n '$p' "$work/dep/deps")" = "  $d/h\\#sh.inc" ]; then
+  pass deps
+else
+  bad deps
+fi
+
+
+# --server: a cached unit reruns when an include is edited or its image
+# removed, and `-o -` is refused
+sock=$(cd "$work" && pwd)/sock
+rm -f "$sock"
+./rvasm --server "$sock" > "$work/server.log" 2>&1 &
+server=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+  [ -S "$sock" ] && break
+  sleep 1
+done
+printf '.include "srv.inc"\n\tret\n' > "$work/srv.S"
+printf '\tnop\n' > "$work/srv.inc"
+srv () { (cd "$work" && "$top/rvasm" --client "$sock" "$@"); }
+if srv -o srv.bin srv.S > "$work/log" 2>&1 &&
+   [ "$(size "$work/srv.bin")" = 8 ] &&
+   printf '\tnop\n\tnop\n' > "$work/srv.inc" &&
+   srv -o srv.bin srv.S > "$work/log" 2>&1 &&
+   [ "$(size "$work/srv.bin")" = 12 ] &&
+   rm "$work/srv.bin" &&
+   srv -o srv.bin srv.S > "$work/log" 2>&1 &&
+   [ "$(size "$work/srv.bin")" = 12 ] &&
+   ! srv -o - srv.S > "$work/log" 2>&1 &&
+   grep -q "not supported with --client" "$work/log"; then
+  pass server
+else
+  bad server
+fi
+kill "$server" 2>/dev/null
+wait "$server" 2>/dev/null
+
+
+# data directives and .incbin, copied both to a file and to a pipe
+printf 'ABCDEFGH' > "$work/blob"
+cat > "$work/data.S" <<'SRC'
+	.byte 1, 2
+	.half 0x304
+	.word 0x8070605
+	.dword 0x100f0e0d0c0b0a09
+	.ascii "hi"
+	.asciz "yo"
+	.space 3, 0xee
+	.align 4
+	.incbin "blob", 2, 3
+	.incbin "blob", 6
+	.align 4
+	nop
+SRC
+want="01 02 04 03 05 06 07 08 09 0a 0b 0c 0d 0e 0f 10"
+want="$want 68 69 79 6f 00 ee ee ee 43 44 45 47 48 00 00 00 00 00 00 00"
+if asm -o "$work/data.bin" "$work/data.S" &&
+   [ "$(od -An -tx1 -v "$work/data.bin" | tr -s ' \n' ' ' |
+        sed 's/^ //; s/ $//')" = "$want" ] &&
+   ./rvasm -o - "$work/data.S" 2> "$work/log" | cat > "$work/data.out" &&
+   cmp -s "$work/data.bin" "$work/data.out"; then
+  pass data
+else
+  bad data
+fi
+printf '\t.incbin "blob", 9\n\t.incbin "nope"\n' > "$work/incbin.S"
+if ! asm -o "$work/incbin.bin" "$work/incbin.S" &&
+   grep -q "1:13: error: range is outside the file" "$work/log" &&
+   grep -q "2:13: error: could not read file" "$work/log"; then
+  pass incbin-errors
+else
+  bad incbin-errors
+fi
+
+
+# odd-sized arena allocations must not push later ones past a block
+awk 'BEGIN {
+  printf "\t.ascii \""
+  for (i = 0; i < 40003; i++) printf "x"
+  printf "\"\n"
+  for (i = 0; i < 545; i++) printf "\t.byte 1\n"
+}' > "$work/arena.S"
+if asm -o "$work/arena.bin" "$work/arena.S" &&
+   [ "$(size "$work/arena.bin")" = 40548 ]; then
+  pass arena
+else
+  bad arena
+fi
+
+
+# a failed run leaves the previous image alone, and says why only once
+printf '\tnop\n' > "$work/good.S"
+printf '\tj nowhere\n' > "$work/undef.S"
+asm -o "$work/keep.bin" "$work/good.S"
+if ! asm -o "$work/keep.bin" "$work/undef.S" &&
+   [ "$(size "$work/keep.bin")" = 4 ] &&
+   ! grep -q "could not write" "$work/log" &&
+   [ -z "$(ls "$work" | grep 'keep\.bin\.')" ]; then
+  pass keep-on-error
+else
+  bad keep-on-error
+fi
+
+
+# a new image replaces the old one by rename, so a reader holding the
+# old one keeps it whole, and gets the usual mode, not mkstemp's 0600
+rm -f "$work/keep.old"
+ln "$work/keep.bin" "$work/keep.old"
+printf '\tnop\n\tnop\n' > "$work/good2.S"
+if (umask 022 && ./rvasm -o "$work/keep.bin" "$work/good2.S") &&
+   [ "$(size "$work/keep.bin")" = 8 ] &&
+   [ "$(size "$work/keep.old")" = 4 ] &&
+   [ "$(ls -l "$work/keep.bin" | cut -c1-10)" = "-rw-r--r--" ]; then
+  pass atomic
+else
+  bad atomic
+fi
+
+
+# a write bigger than the output buffer goes out whole, to a file and
+# to stdout, with the diagnostics apart on stderr
+awk 'BEGIN {
+  printf "\t.ascii \""
+  for (i = 0; i < 70000; i++) printf "%c", 97 + i % 26
+  printf "\"\n\t.align 4\n\tret\n"
+}' > "$work/big.S"
+if asm -o "$work/big.bin" "$work/big.S" &&
+   [ "$(size "$work/big.bin")" = 70004 ] &&
+   ./rvasm -o - "$work/big.S" 2> "$work/log" > "$work/big.out" &&
+   cmp -s "$work/big.bin" "$work/big.out" && ! [ -s "$work/log" ] &&
+   ! ./rvasm -o - "$work/undef.S" 2> "$work/log" > "$work/big.out" &&
+   grep -q "undefined symbol" "$work/log"; then
+  pass big-write
+else
+  bad big-write
+fi
+
+
+# --gc-sections keeps what a numeric pc-relative offset may reach
+printf '\tj #0\n\t.section bar\n\tnop\n' > "$work/gcnum.S"
+if asm --gc-sections -o "$work/gcnum.bin" "$work/gcnum.S" &&
+   [ "$(size "$work/gcnum.bin")" = 8 ]; then
+  pass gc-numeric
+else
+  bad gc-numeric
+fi
+
+
+# --cost: back edges to one header make one loop level
+cat > "$work/loops.S" <<'SRC'
+top:	dec r1
+	cmpi r1, #5
+	je top
+	cmpi r1, #3
+	je top
+inner:	dec r2
+	jne inner
+	jne top
+	ret
+SRC
+if asm -o "$work/loops.bin" "$work/loops.S" &&
+   ./rvdis --cost "$work/loops.bin" > "$work/cost" &&
+   awk '$2 == "100.00" { ok = $5 == 2 }
+        /depth/ { blk = 1; next }
+        blk && NF == 6 && $5 > max { max = $5 }
+        END { exit !(ok && max == 2) }' "$work/cost"; then
+  pass cost-loops
+else
+  bad cost-loops
+fi
+
+
+# --cost: a second back edge to an outer header, after an inner loop,
+# must not deepen the inner loop again
+printf 'H:\tnop\nI:\tdec r1\n\tjne H\nX:\tdec r2\n\tjne I\n\tj H\n\tret\n' \
+  > "$work/nested.S"
+if asm -o "$work/nested.bin" "$work/nested.S" &&
+   ./rvdis --cost "$work/nested.bin" > "$work/cost" &&
+   awk '$2 == "100.00" { ok = $5 == 2 }
+        /depth/ { blk = 1; next }
+        blk && NF == 6 { d[$3] = $5; if ($5 > max) max = $5 }
+        END { exit !(ok && max == 2 && d["00000004"] == 2 &&
+                     d["0000000c"] == 2 && d["00000000"] == 1) }' \
+     "$work/cost"; then
+  pass cost-nested
+else
+  bad cost-nested
+fi
+
+
+# a bad macro or .rept header skips its body instead of parsing it
+cat > "$work/mac.inc" <<'SRC'
+.macro push r
+	mov \r, r1
+.endm
+SRC
+cat > "$work/mac.S" <<'SRC'
+.include "mac.inc"
+.include "mac.inc"
+.rept -1
+	inc \x
+.endr
+	push r2
+SRC
+if ! asm -o "$work/mac.bin" "$work/mac.S" &&
+   [ "$(grep -c 'error:' "$work/log")" = 2 ] &&
+   grep -q "redefinition of macro 'push'" "$work/log" &&
+   grep -q "expected a repeat count" "$work/log"; then
+  pass macro-recovery
+else
+  bad macro-recovery
+fi
+
+
+# --diff: moved code is equal, a retargeted branch is not
+printf 'a:\tinc r1\n\tj a\nb:\tdec r1\n\tret\n' > "$work/d0.S"
+printf '\tnop\na:\tinc r1\n\tj a\nb:\tdec r1\n\tret\n' > "$work/d1.S"
+printf 'a:\tinc r1\n\tj b\nb:\tdec r1\n\tret\n' > "$work/d2.S"
+asm -o "$work/d0.bin" "$work/d0.S" && asm -o "$work/d1.bin" "$work/d1.S" &&
+  asm -o "$work/d2.bin" "$work/d2.S"
+if ./rvdis --diff "$work/d0.bin" "$work/d1.bin" > "$work/diff"; then
+  bad diff-moved
+elif grep -q "2 blocks equal, 0 changed, 1 added" "$work/diff"; then
+  pass diff-moved
+else
+  bad diff-moved
+fi
+if ! ./rvdis --diff "$work/d0.bin" "$work/d2.bin" > "$work/diff" &&
+   grep -q "1 changed" "$work/diff"; then
+  pass diff-retarget
+else
+  bad diff-retarget
+fi
+
+
+# -O2: FILE EXPECTED: the disassembly of $work/FILE.bin, without its
+# header, matches EXPECTED (one instruction per line, `mnemonic ops`)
+opt_case () {
+  printf '%s\n' "$2" > "$work/$1.want"
+  if asm -O2 -o "$work/$1.bin" "$work/$1.S" &&
+     ./rvdis "$work/$1.bin" | awk 'NF >= 3 && $1 ~ /:$/ {
+       $1 = $2 = ""; sub(/^ +/, ""); print }' |
+     sed 's/ *;.*//; s/ *$//; s/  */ /g' > "$work/$1.got" &&
+     cmp -s "$work/$1.want" "$work/$1.got"; then
+    pass "$1"
+  else
+    bad "$1"
+  fi
+}
+
+printf '\tli r1, #5\n\tli r1, #6\n\tret\n' > "$work/opt-dead.S"
+opt_case opt-dead "li r1, #0x6
+ret"
+
+printf '\tmov r2, r1\n\tadd r3, r2, r2\n\tmov r2, r1\n\tret\n' \
+  > "$work/opt-copy.S"
+opt_case opt-copy "mov r2, r1
+add r3, r1, r1
+ret"
+
+# a call may change r2, and the flags from add may reach jne
+printf 'f:\tmov r2, r1\n\tcall f\n\tadd r3, r2, r2\n\tjne f\n\tret\n' \
+  > "$work/opt-call.S"
+opt_case opt-call "mov r2, r1
+call 0
+add r3, r2, r2
+jne 0
+ret"
+
+# removing code would move where `j #3` lands
+printf '\tli r0, #1\n\tj #3\n\tnop\n\tli r5, #9\n\tli r5, #8\n' \
+  > "$work/opt-num.S"
+printf '\tli r0, #7\n\ttrap #0\n' >> "$work/opt-num.S"
+opt_case opt-num "li r0, #0x1
+j 14
+nop
+li r5, #0x9
+li r5, #0x8
+li r0, #0x7
+trap #0x0"
+
+
+exit $fail
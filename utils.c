@@ -16,9 +16,24 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define _XOPEN_SOURCE 700
+#ifdef __linux__
+#define _GNU_SOURCE   /* copy_file_range */
+#endif
+
+#include <errno.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
 #include "utils.h"
 
@@ -28,6 +43,8 @@ Arena *arena_new (size_t sz)
   Arena *ar;
   if (sz == 0)
     sz = DEFARENASZ;
+  /* whole words, so aligning `pos` never passes the end */
+  sz = (sz + 7) & ~(size_t)7;
   ar = (Arena*)malloc(sizeof(Arena)-1 + sz);
   if (!ar)
     return NULL;
@@ -47,16 +64,23 @@ void arena_free (Arena *ar)
 }
 
 
+void arena_reset (Arena *ar)
+{
+  for (; ar; ar = ar->next)
+    ar->pos = 0;
+}
+
+
 void *arena_alloc (Arena *ar, size_t sz)
 {
+  size_t pos;
   if (!ar)
     return NULL;
   /* align to 8 bytes */
-  ar->pos = (ar->pos + 7) & ~7;
-  if (ar->size - ar->pos > sz) {
-    void *ptr = &ar->mem[ar->pos];
-    ar->pos += sz;
-    return ptr;
+  pos = (ar->pos + 7) & ~(size_t)7;
+  if (pos <= ar->size && sz < ar->size - pos) {
+    ar->pos = pos + sz;
+    return &ar->mem[pos];
   }
   /* need more space */
   if (!ar->next) {
@@ -126,6 +150,108 @@ char *read_ascii_file (char *path, size_t *out_sz)
 }
 
 
+int open_file (char *path, size_t *out_sz)
+{
+  struct stat st;
+  int fd;
+#ifdef RVASM_FUZZING
+  /* a FIFO would block here, and is rejected below */
+  fd = open(path, O_RDONLY | O_NONBLOCK);
+#else
+  fd = open(path, O_RDONLY);
+#endif
+  if (fd < 0)
+    return -1;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+#ifdef RVASM_FUZZING
+  if (!S_ISREG(st.st_mode)) {
+    close(fd);
+    return -1;
+  }
+#endif
+  if (out_sz)
+    *out_sz = (size_t)st.st_size;
+  return fd;
+}
+
+
+void close_file (int fd)
+{
+  if (fd >= 0)
+    close(fd);
+}
+
+
+char *map_file (char *path, size_t *out_sz)
+{
+  static char empty[1];
+  struct stat st;
+  void *mem;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+  if (out_sz)
+    *out_sz = (size_t)st.st_size;
+  /* mmap() rejects zero-length maps. */
+  if (st.st_size == 0) {
+    close(fd);
+    return empty;
+  }
+  mem = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED)
+    return NULL;
+  return (char*)mem;
+}
+
+
+void unmap_file (char *mem, size_t sz)
+{
+  if (mem && sz)
+    munmap(mem, sz);
+}
+
+
+unsigned long *line_index (const char *text, size_t sz, unsigned long *n)
+{
+  unsigned long *lines, k = 1;
+  size_t i;
+  for (i = 0; i < sz; i++)
+    k += text[i] == '\n';
+  lines = (unsigned long*)malloc(k * sizeof(unsigned long));
+  if (!lines)
+    return NULL;
+  lines[0] = 0;
+  for (i = 0, k = 1; i < sz; i++)
+    if (text[i] == '\n')
+      lines[k++] = i + 1;
+  *n = k;
+  return lines;
+}
+
+
+char *line_get (char *text, unsigned long *lines, unsigned long n,
+                unsigned long line, size_t *len)
+{
+  char *s;
+  size_t k = 0;
+  if (line < 1 || line > n)
+    return NULL;
+  s = &text[lines[line-1]];
+  while (s[k] && s[k] != '\n' && s[k] != '\r')
+    k++;
+  *len = k;
+  return s;
+}
+
+
 size_t buffed_read (char *buf, size_t sz, FILE *fp)
 {
   size_t curr_pos = 0;
@@ -151,3 +277,308 @@ size_t get_file_size (FILE *fp)
   fseek(fp, saved_pos, SEEK_SET);  /* restore pos */
   return fsize;
 }
+
+
+void ob_init (OutBuf *ob, FILE *fp)
+{
+  ob->fp = fp;
+  ob->pos = 0;
+  ob->err = 0;
+}
+
+
+int ob_flush (OutBuf *ob)
+{
+  /* no stream, discard */
+  if (!ob->fp) {
+    ob->pos = 0;
+    return ob->err;
+  }
+  if (ob->pos && fwrite(ob->buf, 1, ob->pos, ob->fp) != ob->pos)
+    ob->err = 1;
+  ob->pos = 0;
+  if (fflush(ob->fp) != 0)
+    ob->err = 1;
+  return ob->err;
+}
+
+
+/*
+ * Writes the buffer and `data` with a single writev().
+ */
+static void ob_writev (OutBuf *ob, const void *data, size_t sz)
+{
+  struct iovec iov[2];
+  int i, fd;
+
+  if (ob->fp && fflush(ob->fp) != 0)
+    ob->err = 1;
+  if (!ob->fp || ob->err) {
+    ob->pos = 0;
+    return;
+  }
+  fd = fileno(ob->fp);
+  iov[0].iov_base = ob->buf;
+  iov[0].iov_len = ob->pos;
+  iov[1].iov_base = (void*)data;
+  iov[1].iov_len = sz;
+  i = ob->pos ? 0 : 1;
+  while (i < 2) {
+    ssize_t n = writev(fd, &iov[i], 2 - i);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      ob->err = 1;
+      break;
+    }
+    for (; i < 2 && (size_t)n >= iov[i].iov_len; i++)
+      n -= (ssize_t)iov[i].iov_len;
+    if (i < 2) {
+      iov[i].iov_base = (char*)iov[i].iov_base + n;
+      iov[i].iov_len -= (size_t)n;
+    }
+  }
+  ob->pos = 0;
+}
+
+
+void ob_write (OutBuf *ob, const void *data, size_t sz)
+{
+  if (ob->pos + sz > OUTBUFSZ) {
+    /* too big to buffer anyway. */
+    if (sz > OUTBUFSZ) {
+      ob_writev(ob, data, sz);
+      return;
+    }
+    ob_flush(ob);
+  }
+  memcpy(&ob->buf[ob->pos], data, sz);
+  ob->pos += sz;
+}
+
+
+void ob_puts (OutBuf *ob, const char *s)
+{
+  ob_write(ob, s, strlen(s));
+}
+
+
+void ob_jstr (OutBuf *ob, const char *s)
+{
+  static const char hex[] = "0123456789abcdef";
+  char esc[6];
+  ob_write(ob, "\"", 1);
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\') {
+      esc[0] = '\\';
+      esc[1] = (char)c;
+      ob_write(ob, esc, 2);
+    }
+    else if (c < 0x20) {
+      memcpy(esc, "\\u00", 4);
+      esc[4] = hex[c >> 4];
+      esc[5] = hex[c & 15];
+      ob_write(ob, esc, 6);
+    }
+    else
+      ob_write(ob, s, 1);
+  }
+  ob_write(ob, "\"", 1);
+}
+
+
+void ob_putu (OutBuf *ob, unsigned long v)
+{
+  char tmp[24];
+  int i = sizeof(tmp);
+  do {
+    tmp[--i] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  ob_write(ob, &tmp[i], sizeof(tmp) - i);
+}
+
+
+void ob_puti (OutBuf *ob, long v)
+{
+  if (v < 0) {
+    ob_write(ob, "-", 1);
+    ob_putu(ob, -(unsigned long)v);
+  }
+  else
+    ob_putu(ob, (unsigned long)v);
+}
+
+
+void ob_putle (OutBuf *ob, unsigned long v, int n)
+{
+  unsigned char tmp[8];
+  int i;
+  for (i = 0; i < n; i++) {
+    tmp[i] = (unsigned char)(v & 0xff);
+    v >>= 8;
+  }
+  ob_write(ob, tmp, n);
+}
+
+
+/* the portable fallback, through the buffer */
+static ssize_t copy_read (OutBuf *ob, int fd, size_t off, size_t sz)
+{
+  ssize_t n = pread(fd, ob->buf, sz < OUTBUFSZ ? sz : OUTBUFSZ,
+                    (off_t)off);
+  if (n > 0 && fwrite(ob->buf, 1, (size_t)n, ob->fp) != (size_t)n) {
+    ob->err = 1;
+    return -1;
+  }
+  return n;
+}
+
+
+int ob_copy (OutBuf *ob, int fd, size_t off, size_t sz)
+{
+#ifdef __linux__
+  int out, cfr = 1, sf = 1;
+#endif
+  if (ob_flush(ob) || !ob->fp)
+    return 1;
+#ifdef __linux__
+  out = fileno(ob->fp);
+#endif
+  while (sz) {
+    ssize_t n;
+#ifdef __linux__
+    /* in-kernel, and a reflink where the filesystem allows */
+    if (cfr) {
+      loff_t lpos = (loff_t)off;
+      n = copy_file_range(fd, &lpos, out, NULL, sz, 0);
+      if (n < 0) {
+        cfr = 0;  /* e.g. across filesystems, or to a pipe */
+        continue;
+      }
+    }
+    else if (sf) {
+      off_t pos = (off_t)off;
+      n = sendfile(out, fd, &pos, sz);
+      if (n < 0) {
+        sf = 0;
+        continue;
+      }
+    }
+    else
+#endif
+    n = copy_read(ob, fd, off, sz);
+    if (ob->err)
+      return 1;
+    /* cut short since it was parsed */
+    if (n <= 0)
+      return 0;
+    off += (size_t)n;
+    sz -= (size_t)n;
+  }
+  return 1;
+}
+
+
+void bb_init (ByteBuf *bb)
+{
+  bb->data = NULL;
+  bb->len = 0;
+  bb->cap = 0;
+  bb->err = 0;
+}
+
+
+void bb_free (ByteBuf *bb)
+{
+  free(bb->data);
+  bb_init(bb);
+}
+
+
+void bb_write (ByteBuf *bb, const void *data, size_t sz)
+{
+  if (bb->len + sz > bb->cap) {
+    size_t ncap = bb->cap ? bb->cap << 1 : BUFFSZ;
+    char *ndata;
+    while (ncap < bb->len + sz)
+      ncap <<= 1;
+    ndata = (char*)realloc(bb->data, ncap);
+    if (!ndata) {
+      bb->err = 1;
+      return;
+    }
+    bb->data = ndata;
+    bb->cap = ncap;
+  }
+  memcpy(&bb->data[bb->len], data, sz);
+  bb->len += sz;
+}
+
+
+void bb_uleb (ByteBuf *bb, unsigned long v)
+{
+  unsigned char tmp[10];
+  int n = 0;
+  do {
+    tmp[n] = (unsigned char)(v & 0x7f);
+    v >>= 7;
+    if (v)
+      tmp[n] |= 0x80;
+    n++;
+  } while (v);
+  bb_write(bb, tmp, n);
+}
+
+
+void bb_sleb (ByteBuf *bb, long v)
+{
+  unsigned char tmp[10];
+  int n = 0, more = 1;
+  while (more) {
+    unsigned char b = (unsigned char)(v & 0x7f);
+    v >>= 7;  /* arithmetic on all supported targets */
+    if ((v == 0 && !(b & 0x40)) || (v == -1 && (b & 0x40)))
+      more = 0;
+    else
+      b |= 0x80;
+    tmp[n++] = b;
+  }
+  bb_write(bb, tmp, n);
+}
+
+
+unsigned long rd_uleb (const unsigned char **p, const unsigned char *end)
+{
+  unsigned long v = 0;
+  int sh = 0;
+  while (*p < end) {
+    unsigned char b = *(*p)++;
+    if (sh < (int)sizeof(v) * 8)
+      v |= (unsigned long)(b & 0x7f) << sh;
+    sh += 7;
+    if (!(b & 0x80))
+      break;
+  }
+  return v;
+}
+
+
+long rd_sleb (const unsigned char **p, const unsigned char *end)
+{
+  unsigned long v = 0;
+  int sh = 0;
+  unsigned char b = 0;
+  while (*p < end) {
+    b = *(*p)++;
+    if (sh < (int)sizeof(v) * 8)
+      v |= (unsigned long)(b & 0x7f) << sh;
+    sh += 7;
+    if (!(b & 0x80))
+      break;
+  }
+  if (sh < (int)sizeof(v) * 8 && (b & 0x40))
+    v |= ~0ul << sh;
+  return (long)v;
+}
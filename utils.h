@@ -26,6 +26,22 @@
 #define BUFFSZ      (4096)
 #define DEFARENASZ  (16384) /* 16K */
 
+#define OUTBUFSZ    (65536)
+
+typedef struct {
+  FILE  *fp;
+  size_t pos;
+  int    err;
+  char   buf[OUTBUFSZ];
+} OutBuf;
+
+typedef struct {
+  char  *data;
+  size_t len;
+  size_t cap;
+  int    err;
+} ByteBuf;
+
 typedef struct Arena Arena;
 struct Arena {
   Arena *next;
@@ -44,6 +60,11 @@ Arena *arena_new (size_t sz);
  */
 void arena_free (Arena *ar);
 
+/*
+ * Empties an arena but keeps its blocks for reuse.
+ */
+void arena_reset (Arena *ar);
+
 /*
  * Allocate from stack. Returns an 8-byte aligned block.
  */
@@ -59,6 +80,35 @@ char *read_bin_file (char *path, size_t *out_sz);
  */
 char *read_ascii_file (char *path, size_t *out_sz);
 
+/*
+ * Opens a file read-only and gets its size. Returns -1 on error.
+ */
+int open_file (char *path, size_t *out_sz);
+void close_file (int fd);
+
+/*
+ * Maps a file read-only into memory. Release with unmap_file().
+ */
+char *map_file (char *path, size_t *out_sz);
+
+/*
+ * Unmaps a file mapped by map_file().
+ */
+void unmap_file (char *mem, size_t sz);
+
+/*
+ * Start offsets of the lines of `text`, their count in *n. Returns
+ * NULL when out of memory.
+ */
+unsigned long *line_index (const char *text, size_t sz, unsigned long *n);
+
+/*
+ * Line `line` (1-based) of `text`, indexed by line_index(), without
+ * its terminator. Returns NULL if there is no such line.
+ */
+char *line_get (char *text, unsigned long *lines, unsigned long n,
+                unsigned long line, size_t *len);
+
 /*
  * Buffered read.
  */
@@ -69,4 +119,66 @@ size_t buffed_read (char *buf, size_t sz, FILE *fp);
  */
 size_t get_file_size (FILE *fp);
 
+/*
+ * Starts buffered output to `fp`. A NULL `fp` discards everything.
+ */
+void ob_init (OutBuf *ob, FILE *fp);
+
+/*
+ * Writes out whatever is buffered. Returns non-zero on error.
+ */
+int ob_flush (OutBuf *ob);
+
+/*
+ * Writes `sz` bytes of the file open as `fd` from `off`, after
+ * flushing. The kernel copies it where it can. Returns 0 if the file
+ * ended first.
+ */
+int ob_copy (OutBuf *ob, int fd, size_t off, size_t sz);
+
+/*
+ * Appends raw bytes.
+ */
+void ob_write (OutBuf *ob, const void *data, size_t sz);
+
+/*
+ * Appends a NUL-terminated string.
+ */
+void ob_puts (OutBuf *ob, const char *s);
+
+/*
+ * Appends a string as a quoted JSON string.
+ */
+void ob_jstr (OutBuf *ob, const char *s);
+
+/*
+ * Appends a number in decimal.
+ */
+void ob_putu (OutBuf *ob, unsigned long v);
+void ob_puti (OutBuf *ob, long v);
+
+/*
+ * Appends `v` as a little-endian integer of `n` bytes.
+ */
+void ob_putle (OutBuf *ob, unsigned long v, int n);
+
+/*
+ * Growable byte buffer. Appends are amortized O(1).
+ */
+void bb_init (ByteBuf *bb);
+void bb_free (ByteBuf *bb);
+void bb_write (ByteBuf *bb, const void *data, size_t sz);
+
+/*
+ * Appends a LEB128-encoded number.
+ */
+void bb_uleb (ByteBuf *bb, unsigned long v);
+void bb_sleb (ByteBuf *bb, long v);
+
+/*
+ * Reads a LEB128-encoded number at *p, advancing it. Stops at `end`.
+ */
+unsigned long rd_uleb (const unsigned char **p, const unsigned char *end);
+long rd_sleb (const unsigned char **p, const unsigned char *end);
+
 #endif /* RVASM_UTILS_H_ */